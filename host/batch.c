@@ -0,0 +1,137 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//
+//	Node has a 2 - 6 byte reading every 'gap' us and sends it to gateway, first one message per
+//	reading and then packed with nrf24l01-batch.c. Gateway unpacks and counts readings,
+//	send_us is time node spent sending (radio in TX, MCU waiting).
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+#include "nrf24l01.h"
+#include "nrf24l01-batch.h"
+#include "timer.h"
+
+static sim_radio gateway_chip, node_chip;
+static nrf24_t gateway = NRF24_RADIO(gateway_chip.ce, 0, gateway_chip.csn, 0, 0);
+static nrf24_t node = NRF24_RADIO(node_chip.ce, 0, node_chip.csn, 0, 1);
+static uint32_t records, bytes;
+
+static void gateway_isr(void) { nrf24_irq(&gateway); }
+static void node_isr(void) { nrf24_irq(&node); }
+
+static void handle(const uint8_t *data, uint8_t length)
+{
+	records++;
+	bytes += length;
+}
+
+//	Gateway main loop, packed messages are split into readings
+static void gateway_loop(bool pack)
+{
+	nrf24_frame *frame;
+	
+	while ((frame = nrf24_peek(&gateway)))
+	{
+		if (pack) nrf24_batch_unpack(frame,handle);
+		else handle(frame->data,frame->length);
+		nrf24_release(&gateway);
+	}
+}
+
+static void run(bool pack, uint16_t count, uint32_t gap, double loss)
+{
+	nrf24_batch batch;
+	nrf24_stats stats;
+	uint8_t reading[6];
+	uint8_t length;
+	uint32_t next = 0, messages = 0, busy = 0, start;
+	uint16_t i = 0;
+	
+	sim_init(1);
+	sim_set_loss(loss);
+	srand(1);
+	gateway_chip.isr = gateway_isr;
+	node_chip.isr = node_isr;
+	sim_add(&gateway_chip);
+	sim_add(&node_chip);
+	if (nrf24_init(&gateway) != NRF24_OK || nrf24_init(&node) != NRF24_OK)
+	{
+		printf("Radio did not answer\n");
+		exit(1);
+	}
+	nrf24_start_listening(&gateway);
+	nrf24_batch_init(&batch,&node);
+	records = bytes = 0;
+	
+	while (i < count || batch.length)
+	{
+		if (i < count && timer_micros() >= next)
+		{
+			length = 2 + rand() % 5;
+			for (uint8_t j = 0; j < length; j++) reading[j] = i + j;
+			start = timer_micros();
+			if (pack) nrf24_batch_add(&batch,reading,length);
+			else
+			{
+				nrf24_send(&node,reading,length);
+				messages++;
+			}
+			busy += timer_micros() - start;
+			next += gap;
+			i++;
+		}
+		
+		// Last ones go out with deadline
+		start = timer_micros();
+		if (pack) nrf24_batch_poll(&batch);
+		busy += timer_micros() - start;
+		
+		gateway_loop(pack);
+		hal_delay_us(20);
+	}
+	hal_delay_ms(1);
+	gateway_loop(pack);
+	
+	nrf24_get_stats(&node,&stats);
+	printf("%-6s %8lu %8u %8lu %8lu %8lu %8lu %8lu\n",pack ? "batch" : "single",(unsigned long)gap,count,
+		(unsigned long)(pack ? batch.messages : messages),(unsigned long)records,(unsigned long)bytes,
+		(unsigned long)busy,(unsigned long)stats.spi_bytes);
+}
+
+int main(int argc, char **argv)
+{
+	uint16_t count = argc > 1 ? atoi(argv[1]) : 1000;
+	double loss = argc > 2 ? atof(argv[2]) : 0;
+	uint32_t gaps[] = { 5000, 1000, 300 };
+	
+	printf("%-6s %8s %8s %8s %8s %8s %8s %8s\n","mode","gap_us","readings","messages","received","bytes","send_us","spi");
+	for (uint8_t i = 0; i < sizeof(gaps) / sizeof(gaps[0]); i++)
+	{
+		run(false,count,gaps[i],loss);
+		run(true,count,gaps[i],loss);
+	}
+	return 0;
+}
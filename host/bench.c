@@ -0,0 +1,222 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//
+//	Node sends messages to gateway over simulated air with blocking nrf24_send(), one CSV row
+//	per payload length, retransmit setting and air loss. Data rate, AUTO_ACK and DYN_PAYLOAD
+//	are compile time settings of the driver, 'make bench' builds every combination.
+//	Columns are in BENCH_HEADER, printed with -H. Rows with ard_us 'arq' are one bulk transfer
+//	of BENCH_MESSAGES full frames with nrf24l01-arq.c instead, 'arc' is its window.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+#include "nrf24l01.h"
+#include "nrf24l01-mnemonics.h"
+#include "nrf24l01-arq.h"
+
+#define BENCH_HEADER	"datarate,auto_ack,dyn_payload,payload,ard_us,arc,air_loss,packets_s,goodput_bps,p50_us,p99_us,spi_bytes_packet,loss"
+#define BENCH_MESSAGES	500
+
+static sim_radio gateway_chip, node_chip;
+static nrf24_t gateway = NRF24_RADIO(gateway_chip.ce, 0, gateway_chip.csn, 0, 0);
+static nrf24_t node = NRF24_RADIO(node_chip.ce, 0, node_chip.csn, 0, 1);
+
+static nrf24_arq gateway_arq, node_arq;
+static bool arq_running;
+static uint32_t arq_received;
+
+static void gateway_isr(void)
+{
+	nrf24_frame frame;
+	
+	nrf24_irq(&gateway);
+	// Frames are taken from the queue as fast as they come, like from nrf24_on_receive() callback
+	if (arq_running) while (nrf24_receive(&gateway,&frame)) nrf24_arq_receive(&gateway_arq,&frame);
+}
+
+//	Main loop of gateway, runs while node waits
+static void gateway_loop(void)
+{
+	nrf24_arq_poll(&gateway_arq);
+}
+
+static void arq_deliver(const uint8_t *data, uint8_t length)
+{
+	arq_received += length;
+}
+
+static void node_isr(void)
+{
+	nrf24_irq(&node);
+}
+
+//	Retransmit settings, delay 0 is nrf24_auto_retries()
+static const struct
+{
+	uint16_t delay;
+	uint8_t count;
+} retries[] =
+{
+	{ 0, 0 }, { 250, 3 }, { 500, 3 }, { 1000, 15 }, { 4000, 15 }
+};
+
+static const double losses[] = { 0, 0.05, 0.2 };
+
+static int compare(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+static void bench_setup(double loss)
+{
+	sim_init(1);
+	sim_set_loss(loss);
+	gateway_chip.isr = gateway_isr;
+	node_chip.isr = node_isr;
+	sim_add(&gateway_chip);
+	sim_add(&node_chip);
+	nrf24_init(&gateway);
+	nrf24_init(&node);
+	nrf24_start_listening(&gateway);
+}
+
+static void bench_run(uint8_t length, uint8_t retry, double loss)
+{
+	static uint32_t latency[BENCH_MESSAGES];
+	uint8_t message[32], rf_setup, en_aa, feature, value;
+	uint32_t received = 0;
+	uint64_t start, sent;
+	nrf24_frame frame;
+	nrf24_stats node_stats, gateway_stats;
+	double seconds;
+	const char *rate;
+	char delay[8] = "auto";
+	
+	bench_setup(loss);
+	nrf24_read(&node,RF_SETUP,&rf_setup,1);
+	nrf24_read(&node,EN_AA,&en_aa,1);
+	nrf24_read(&node,FEATURE,&feature,1);
+	
+	if (retries[retry].delay) nrf24_set_retries(&node,retries[retry].delay,retries[retry].count);
+	else if (en_aa) nrf24_auto_retries(&node,0);
+	nrf24_clear_stats(&node);
+	nrf24_clear_stats(&gateway);
+	
+	start = sim_time();
+	for (uint16_t i = 0; i < BENCH_MESSAGES; i++)
+	{
+		for (uint8_t j = 0; j < length; j++) message[j] = i + j;
+		sent = sim_time();
+		nrf24_send(&node,message,length);
+		latency[i] = (sim_time() - sent) / 1000;
+		while (nrf24_receive(&gateway,&frame)) received++;
+	}
+	seconds = (sim_time() - start) / 1e9;
+	hal_delay_ms(1);
+	while (nrf24_receive(&gateway,&frame)) received++;
+	
+	nrf24_get_stats(&node,&node_stats);
+	nrf24_get_stats(&gateway,&gateway_stats);
+	nrf24_read(&node,SETUP_RETR,&value,1);
+	qsort(latency,BENCH_MESSAGES,sizeof(uint32_t),compare);
+	
+	if (!en_aa) strcpy(delay,"none");
+	else if (retries[retry].delay) snprintf(delay,sizeof(delay),"%u",retries[retry].delay);
+	if (rf_setup & (1 << RF_DR_LOW)) rate = "250kbps";
+	else if (rf_setup & (1 << RF_DR_HIGH)) rate = "2mbps";
+	else rate = "1mbps";
+	
+	printf("%s,%d,%d,%u,%s,%u,%.2f,%.1f,%.0f,%u,%u,%.1f,%.4f\n",
+		rate,en_aa != 0,(feature >> EN_DPL) & 1,length,delay,en_aa ? value & 0x0F : 0,loss,received / seconds,received * length * 8 / seconds,
+		latency[BENCH_MESSAGES / 2],latency[BENCH_MESSAGES * 99 / 100],
+		(double)(node_stats.spi_bytes + gateway_stats.spi_bytes) / BENCH_MESSAGES,
+		1.0 - (double)received / BENCH_MESSAGES);
+}
+
+static void bench_arq(double loss)
+{
+	static uint8_t data[BENCH_MESSAGES * ARQ_DATA];
+	uint8_t rf_setup, en_aa, feature;
+	uint64_t start;
+	nrf24_stats node_stats, gateway_stats;
+	double seconds;
+	const char *rate;
+	
+	bench_setup(loss);
+	nrf24_read(&node,RF_SETUP,&rf_setup,1);
+	nrf24_read(&node,EN_AA,&en_aa,1);
+	nrf24_read(&node,FEATURE,&feature,1);
+	for (uint16_t i = 0; i < sizeof(data); i++) data[i] = i;
+	nrf24_arq_init(&gateway_arq,&gateway,arq_deliver);
+	nrf24_arq_init(&node_arq,&node,0);
+	sim_set_idle(gateway_loop);
+	arq_received = 0;
+	arq_running = true;
+	nrf24_clear_stats(&node);
+	nrf24_clear_stats(&gateway);
+	
+	start = sim_time();
+	nrf24_arq_send(&node_arq,data,sizeof(data));
+	seconds = (sim_time() - start) / 1e9;
+	arq_running = false;
+	
+	nrf24_get_stats(&node,&node_stats);
+	nrf24_get_stats(&gateway,&gateway_stats);
+	if (rf_setup & (1 << RF_DR_LOW)) rate = "250kbps";
+	else if (rf_setup & (1 << RF_DR_HIGH)) rate = "2mbps";
+	else rate = "1mbps";
+	
+	printf("%s,%d,%d,%u,arq,%u,%.2f,%.1f,%.0f,,,%.1f,%.4f\n",
+		rate,en_aa != 0,(feature >> EN_DPL) & 1,ARQ_DATA,ARQ_WINDOW,loss,arq_received / ARQ_DATA / seconds,arq_received * 8 / seconds,
+		(double)(node_stats.spi_bytes + gateway_stats.spi_bytes) / BENCH_MESSAGES,
+		1.0 - (double)arq_received / sizeof(data));
+}
+
+int main(int argc, char **argv)
+{
+	uint8_t en_aa;
+	
+	if (argc > 1 && !strcmp(argv[1],"-H"))
+	{
+		printf("%s\n",BENCH_HEADER);
+		return 0;
+	}
+	
+	// Retransmit settings only matter with AUTO_ACK
+	bench_setup(0);
+	nrf24_read(&node,EN_AA,&en_aa,1);
+	
+	for (uint8_t l = 0; l < sizeof(losses) / sizeof(losses[0]); l++)
+	{
+		for (uint8_t r = 0; r < (en_aa ? sizeof(retries) / sizeof(retries[0]) : 1); r++)
+		{
+			for (uint8_t length = 1; length <= 32; length++) bench_run(length,r,losses[l]);
+		}
+		bench_arq(losses[l]);
+	}
+	return 0;
+}
@@ -0,0 +1,469 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+//
+//	Short checks of driver features against simulated radios, one function per feature.
+//	Prints ok/FAIL per check and exits with number of failures, 'make check' runs it
+//	with and without DYN_PAYLOAD.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+#include "nrf24l01.h"
+#include "nrf24l01-mnemonics.h"
+#include "nrf24l01-frag.h"
+#include "nrf24l01-hop.h"
+#include "nrf24l01-arq.h"
+#include "nrf24l01-mesh.h"
+#include "nrf24l01-tdma.h"
+#include "nrf24l01-csma.h"
+#include "timer.h"
+
+static sim_radio gateway_chip, node_chip;
+static nrf24_t gateway, node;
+static uint8_t failures;
+
+static void gateway_isr(void)
+{
+	nrf24_irq(&gateway);
+}
+
+static void node_isr(void)
+{
+	nrf24_irq(&node);
+}
+
+static void check(const char *name, bool passed)
+{
+	printf("%-44s %s\n",name,passed ? "ok" : "FAIL");
+	if (!passed) failures++;
+}
+
+// Fresh air with gateway and node after power on reset
+static bool setup(void)
+{
+	sim_init(1);
+	gateway_chip.isr = gateway_isr;
+	node_chip.isr = node_isr;
+	sim_add(&gateway_chip);
+	sim_add(&node_chip);
+	gateway = (nrf24_t)NRF24_RADIO(gateway_chip.ce, 0, gateway_chip.csn, 0, 0);
+	node = (nrf24_t)NRF24_RADIO(node_chip.ce, 0, node_chip.csn, 0, 1);
+	return nrf24_init(&gateway) == NRF24_OK && nrf24_init(&node) == NRF24_OK;
+}
+
+// Registers changed behind driver's back (e.g. brown-out) are written back from RAM copy
+static void check_sync(void)
+{
+	uint8_t channel = node.shadow.reg[RF_CH];
+	uint8_t address[5];
+	
+	memcpy(address,node.shadow.rx_addr_p1,5);
+	check("sync: chip matches RAM copy after init",nrf24_sync(&node) == 0);
+	
+	node_chip.reg[RF_CH] = channel + 1;
+	node_chip.rx_addr_p1[2] ^= 0xFF;
+	check("sync: two changed registers found",nrf24_sync(&node) == 2);
+	check("sync: RF_CH written back",node_chip.reg[RF_CH] == channel);
+	check("sync: RX_ADDR_P1 written back",!memcmp(node_chip.rx_addr_p1,address,5));
+	check("sync: nothing left to fix",nrf24_sync(&node) == 0);
+}
+
+// String of wrong length never goes on air
+static void check_send_message(void)
+{
+	nrf24_stats stats;
+	
+	nrf24_start_listening(&gateway);
+	check("send message: empty string refused",nrf24_send_message(&node,"") == 0);
+	check("send message: 33 bytes refused",nrf24_send_message(&node,"123456789012345678901234567890123") == 0);
+	nrf24_get_stats(&node,&stats);
+	check("send message: nothing sent",stats.sent == 0);
+	check("send message: 32 bytes sent",nrf24_send_message(&node,"12345678901234567890123456789012") == 1);
+}
+
+// Gateway without IRQ lets RX FIFO fill up, overflow is counted once when it is drained
+static void check_rx_full(void)
+{
+	uint8_t message[4] = { 1, 2, 3, 4 };
+	nrf24_stats stats;
+	nrf24_frame frame;
+	
+	gateway_chip.isr = 0;
+	nrf24_start_listening(&gateway);
+	nrf24_send(&node,message,sizeof(message));
+	nrf24_available(&gateway);
+	nrf24_get_stats(&gateway,&stats);
+	check("rx full: not counted for one message",stats.rx_full == 0 && stats.received == 1);
+	while (nrf24_receive(&gateway,&frame));
+	nrf24_clear_stats(&gateway);
+	for (uint8_t i = 0; i < 4; i++) nrf24_send_noack(&node,message,sizeof(message));
+	nrf24_available(&gateway);
+	nrf24_get_stats(&gateway,&stats);
+	check("rx full: RX_FULL counted once",stats.rx_full == 1 && stats.received == 3);
+	gateway_chip.isr = gateway_isr;
+}
+
+// Second nrf24_init() on a configured chip (MCU reset) keeps registers outside init image
+static void check_warm_init(void)
+{
+	uint8_t address[5] = { 0x31, 0x32, 0x33, 0x34, 0x35 };
+	uint8_t lsb = 0x36, width = 0x02;
+	
+	nrf24_open_pipe(&node,1,address);
+	nrf24_open_pipe(&node,2,&lsb);
+	nrf24_write(&node,SETUP_AW,&width,1);
+	check("warm init: chip answers again",nrf24_init(&node) == NRF24_OK);
+	check("warm init: RAM copy read from chip",!memcmp(node.shadow.rx_addr_p1,address,5) && node.shadow.rx_addr_p2[0] == lsb && node.shadow.reg[SETUP_AW] == width);
+	check("warm init: sync finds nothing to fix",nrf24_sync(&node) == 0);
+	check("warm init: RX_ADDR_P2 kept on chip",node_chip.reg[RX_ADDR_P2] == lsb);
+}
+
+static nrf24_frag frag;
+static uint8_t frag_done;
+
+static void gateway_frag(void)
+{
+	nrf24_frame frame;
+	
+	while (nrf24_receive(&gateway,&frame)) frag_done += nrf24_frag_receive(&frag,&frame);
+}
+
+// 200 byte message is split into 7 fragments and put back together with its own length
+static void check_frag(void)
+{
+	uint8_t message[200];
+	bool same;
+	
+	for (uint8_t i = 0; i < sizeof(message); i++) message[i] = i * 7;
+	nrf24_frag_init(&frag);
+	frag_done = 0;
+	nrf24_start_listening(&gateway);
+	sim_set_idle(gateway_frag);
+	check("frag: 200 bytes sent",nrf24_frag_send(&node,message,sizeof(message)) == NRF24_OK);
+	hal_delay_ms(1);
+	gateway_frag();
+	same = frag.length == sizeof(message) && !memcmp(frag.buffer,message,sizeof(message));
+	check("frag: message put together once",frag_done == 1);
+	check("frag: same length and content",same);
+	check("frag: too long message refused",nrf24_frag_send(&node,message,FRAG_MAX_FRAGMENTS * FRAG_DATA + 1) == NRF24_ERR_LENGTH);
+}
+
+// Send of its own flushes loaded ACK payload (chip would send it as data), next one answers
+static void check_ack_payload(void)
+{
+	uint8_t address[5] = { 0xd1, 0xd2, 0xd3, 0xd4, 0xd5 };
+	uint8_t reply[4] = { 'p', 'o', 'n', 'g' }, poll = 1, message = 2;
+	nrf24_frame frame;
+	nrf24_stats stats;
+	
+	if (nrf24_write_ack_payload(&gateway,1,reply,sizeof(reply)) == NRF24_ERR_NO_ACK)
+	{
+		check("ack payload: refused without AUTO_ACK",true);
+		return;
+	}
+	nrf24_open_pipe(&gateway,1,address);
+	nrf24_start_listening(&gateway);
+	nrf24_start_listening(&node);
+	check("ack payload: gateway sends in between",nrf24_send(&gateway,&message,1) == NRF24_OK);
+	hal_delay_ms(1);
+	check("ack payload: node got gateway's message",nrf24_receive(&node,&frame) && frame.data[0] == message);
+	check("ack payload: not sent as data",!nrf24_receive(&node,&frame));
+	nrf24_get_stats(&gateway,&stats);
+	check("ack payload: flushed and counted",stats.ack_dropped == 1 && gateway_chip.tx_count == 0);
+	
+	nrf24_set_tx_address(&node,address);
+	check("ack payload: request after send gets empty ACK",nrf24_request(&node,&poll,1,&frame) == NRF24_ERR_EMPTY);
+	nrf24_write_ack_payload(&gateway,1,reply,sizeof(reply));
+	check("ack payload: request answered",nrf24_request(&node,&poll,1,&frame) == NRF24_OK);
+	check("ack payload: answer is loaded payload",frame.length >= sizeof(reply) && !memcmp(frame.data,reply,sizeof(reply)));
+}
+
+static nrf24_hop gateway_hop, node_hop;
+
+// Both sides hop for 'ms', node takes beacons from its queue. Returns ms until node synced
+static uint16_t hop_run(uint16_t ms)
+{
+	nrf24_frame frame;
+	uint16_t synced = ms;
+	
+	for (uint16_t i = 0; i < ms; i++)
+	{
+		nrf24_hop_poll(&gateway_hop);
+		nrf24_hop_poll(&node_hop);
+		while (nrf24_receive(&node,&frame)) nrf24_hop_receive(&node_hop,&frame);
+		if (node_hop.synced && synced == ms) synced = i;
+		hal_delay_ms(1);
+	}
+	return synced;
+}
+
+// Node follows gateway, loses it out of range and finds it again within a few hops
+static void check_hop(void)
+{
+	uint8_t busy[NRF24_SCAN_BYTES] = { 0 };
+	nrf24_frame frame = { .length = 2, .data = { HOP_BEACON, 3 } };
+	nrf24_stats stats;
+	
+	nrf24_start_listening(&node);
+	nrf24_hop_init(&node_hop,&node,0x2a17,busy,false);
+	nrf24_hop_init(&gateway_hop,&gateway,0x2a17,busy,true);
+	hop_run(20 * HOP_DWELL);
+	check("hop: node follows gateway",node_hop.synced && node_hop.index == gateway_hop.index);
+	nrf24_get_stats(&gateway,&stats);
+	check("hop: beacons go out without ACK",stats.max_rt == 0 && stats.retransmits == 0);
+	check("hop: application frame is not a beacon",!nrf24_hop_receive(&node_hop,&frame));
+	
+	sim_set_range(&gateway_chip,&node_chip,false);
+	hop_run(20 * HOP_DWELL);
+	check("hop: node lost out of range",!node_hop.synced);
+	sim_set_range(&gateway_chip,&node_chip,true);
+	check("hop: back in sync within 3 hops",hop_run(20 * HOP_DWELL) < 3 * HOP_DWELL);
+	check("hop: node follows gateway again",node_hop.synced && node_hop.index == gateway_hop.index);
+}
+
+static nrf24_arq gateway_arq, node_arq;
+static uint8_t arq_data[1000];
+static uint16_t arq_length;
+static bool arq_same;
+
+static void arq_deliver(const uint8_t *data, uint8_t length)
+{
+	if (arq_length + length > sizeof(arq_data) || memcmp(data,&arq_data[arq_length],length)) arq_same = false;
+	arq_length += length;
+}
+
+static void gateway_arq_receive(nrf24_t *radio)
+{
+	nrf24_frame frame;
+	
+	while (nrf24_receive(radio,&frame)) nrf24_arq_receive(&gateway_arq,&frame);
+}
+
+static void gateway_arq_poll(void)
+{
+	nrf24_arq_poll(&gateway_arq);
+}
+
+// 1000 bytes over lossy air come out in order with nothing added
+static void check_arq(void)
+{
+	for (uint16_t i = 0; i < sizeof(arq_data); i++) arq_data[i] = i * 13;
+	nrf24_arq_init(&gateway_arq,&gateway,arq_deliver);
+	nrf24_arq_init(&node_arq,&node,0);
+	nrf24_on_receive(&gateway,gateway_arq_receive);
+	nrf24_start_listening(&gateway);
+	sim_set_idle(gateway_arq_poll);
+	sim_set_loss(0.05);
+	arq_length = 0;
+	arq_same = true;
+	check("arq: 1000 bytes sent",nrf24_arq_send(&node_arq,arq_data,sizeof(arq_data)) == NRF24_OK);
+	sim_set_loss(0);
+	check("arq: 1000 bytes delivered",arq_length == sizeof(arq_data));
+	check("arq: same content in order",arq_same);
+	check("arq: lost frames sent again",node_arq.retransmits > 0);
+}
+
+// Node next to gateway, message arrives with its own length
+static void check_mesh(void)
+{
+	nrf24_mesh gateway_mesh, node_mesh;
+	uint8_t message[5] = { 1, 2, 3, 4, 5 };
+	nrf24_frame frame;
+	uint8_t delivered = 0;
+	
+	nrf24_mesh_init(&gateway_mesh,&gateway,MESH_GATEWAY,false);
+	nrf24_mesh_init(&node_mesh,&node,1,false);
+	nrf24_mesh_route(&node_mesh,MESH_GATEWAY,MESH_GATEWAY,1);
+	nrf24_start_listening(&gateway);
+	check("mesh: node sends to gateway",nrf24_mesh_send(&node_mesh,MESH_GATEWAY,message,sizeof(message)) == NRF24_OK);
+	hal_delay_ms(1);
+	while (nrf24_receive(&gateway,&frame)) delivered += nrf24_mesh_receive(&gateway_mesh,&frame);
+	check("mesh: delivered once from node 1",delivered == 1 && gateway_mesh.source == 1);
+	check("mesh: same length and content",gateway_mesh.length == sizeof(message) && !memcmp(gateway_mesh.data,message,sizeof(message)));
+}
+
+static nrf24_tdma gateway_tdma, node_tdma;
+static uint16_t tdma_received;
+
+// Main loops of both MCUs every 50us for 'frames' superframes
+static void tdma_run(uint16_t frames)
+{
+	nrf24_frame frame;
+	
+	for (uint32_t i = 0; i < frames * TDMA_FRAME / 50; i++)
+	{
+		nrf24_tdma_poll(&gateway_tdma);
+		nrf24_tdma_poll(&node_tdma);
+		while (nrf24_receive(&gateway,&frame))
+		{
+			if (!nrf24_tdma_receive(&gateway_tdma,&frame)) tdma_received++;
+		}
+		while (nrf24_receive(&node,&frame)) nrf24_tdma_receive(&node_tdma,&frame);
+		hal_delay_us(50);
+	}
+}
+
+static bool tdma_owner(uint8_t node_id)
+{
+	for (uint8_t i = 0; i < TDMA_SLOTS; i++)
+	{
+		if (gateway_tdma.owner[i] == node_id) return true;
+	}
+	return false;
+}
+
+// Node joins, keeps its slot while idle and loses it by leaving or going away
+static void check_tdma(void)
+{
+	uint8_t reading[4] = { 1, 2, 3, 4 };
+	
+	tdma_received = 0;
+	nrf24_tdma_init(&gateway_tdma,&gateway,TDMA_GATEWAY,false);
+	nrf24_tdma_init(&node_tdma,&node,1,false);
+	check("tdma: beacon delay covers settling and air time",node_tdma.beacon_delay > 145 && node_tdma.beacon_delay < 1000);
+	tdma_run(10);
+	check("tdma: node joins",node_tdma.slot != 0xFF && tdma_owner(1));
+	nrf24_tdma_send(&node_tdma,reading,sizeof(reading));
+	tdma_run(2);
+	check("tdma: reading sent within one superframe",tdma_received == 1 && node_tdma.latency < TDMA_FRAME + TDMA_SLOT);
+	tdma_run(2 * TDMA_IDLE);
+	check("tdma: idle node keeps its slot",node_tdma.slot != 0xFF && tdma_owner(1));
+	
+	nrf24_tdma_leave(&node_tdma);
+	tdma_run(3);
+	check("tdma: slot freed after leave",node_tdma.slot == 0xFF && !tdma_owner(1));
+	tdma_run(10);
+	check("tdma: node does not join again by itself",!tdma_owner(1));
+	
+	nrf24_tdma_send(&node_tdma,reading,sizeof(reading));
+	tdma_run(10);
+	check("tdma: node joins again for next reading",tdma_owner(1) && tdma_received == 2);
+	sim_set_range(&gateway_chip,&node_chip,false);
+	tdma_run(TDMA_IDLE + 2);
+	check("tdma: slot freed when node goes away",!tdma_owner(1));
+	sim_set_range(&gateway_chip,&node_chip,true);
+}
+
+// Poll until message is out, returns longest time one poll took in us
+static uint32_t csma_run(nrf24_csma *csma)
+{
+	uint32_t start, longest = 0;
+	bool more = true;
+	
+	while (more)
+	{
+		start = timer_micros();
+		more = nrf24_csma_poll(csma);
+		if (timer_micros() - start > longest) longest = timer_micros() - start;
+		hal_delay_us(10);
+	}
+	return longest;
+}
+
+// Listen before talk samples without blocking and reports MAX_RT of asynchronous send
+static void check_csma(void)
+{
+	nrf24_csma csma;
+	nrf24_stats stats;
+	uint8_t reading[6] = { 6, 5, 4, 3, 2, 1 };
+	nrf24_frame frame;
+	
+	nrf24_start_listening(&gateway);
+	nrf24_csma_init(&csma,&node,1);
+	nrf24_csma_send(&csma,reading,sizeof(reading));
+	check("csma: poll does not wait for sample",csma_run(&csma) < NRF24_CARRIER_TIME);
+	check("csma: message delivered",csma.result == NRF24_OK && nrf24_receive(&gateway,&frame) && !memcmp(frame.data,reading,sizeof(reading)));
+	
+	sim_set_range(&gateway_chip,&node_chip,false);
+	nrf24_csma_send(&csma,reading,sizeof(reading));
+	csma_run(&csma);
+	nrf24_get_stats(&node,&stats);
+	check("csma: result from asynchronous send",csma.result == (stats.max_rt ? NRF24_ERR_MAX_RT : NRF24_OK) && nrf24_async_result(&node) == csma.result);
+	sim_set_range(&gateway_chip,&node_chip,true);
+}
+
+static uint8_t pipe_data[6];
+
+static void pipe_handler(nrf24_t *radio, nrf24_frame *frame)
+{
+	pipe_data[frame->pipe] = frame->data[0];
+}
+
+// Gateway listens on six addresses, every message goes to handler of pipe it came on
+static void check_pipes(void)
+{
+	uint8_t address[5] = { 0xc1, 0xb2, 0xb3, 0xb4, 0xb5 };
+	uint8_t pipe0[5] = { 0xa0, 0xa1, 0xa2, 0xa3, 0xa4 };
+	uint8_t message[8];
+	bool delivered = true;
+	
+	check("pipes: pipe 6 refused",nrf24_open_pipe(&gateway,6,address) == NRF24_ERR_PIPE);
+	nrf24_open_pipe(&gateway,0,pipe0);
+	nrf24_open_pipe(&gateway,1,address);
+	for (uint8_t pipe = 2; pipe < 6; pipe++)
+	{
+		uint8_t lsb = 0xc0 + pipe;
+		nrf24_open_pipe(&gateway,pipe,&lsb);
+	}
+	for (uint8_t pipe = 0; pipe < 6; pipe++) nrf24_on_pipe(&gateway,pipe,pipe_handler);
+	check("pipes: all six enabled",gateway_chip.reg[EN_RXADDR] == 0x3F);
+	nrf24_start_listening(&gateway);
+	
+	memset(pipe_data,0,sizeof(pipe_data));
+	for (uint8_t pipe = 0; pipe < 6; pipe++)
+	{
+		if (pipe == 0) nrf24_set_tx_address(&node,pipe0);
+		else
+		{
+			address[0] = 0xc0 + pipe;
+			nrf24_set_tx_address(&node,address);
+		}
+		memset(message,0x10 + pipe,sizeof(message));
+		nrf24_send(&node,message,sizeof(message));
+		hal_delay_ms(1);
+	}
+	check("pipes: TX flags cleared after send (IRQ high)",!(node_chip.reg[STATUS] & ((1 << TX_DS) | (1 << MAX_RT))));
+	check("pipes: six messages dispatched",nrf24_dispatch(&gateway) == 6);
+	for (uint8_t pipe = 0; pipe < 6; pipe++) delivered &= pipe_data[pipe] == 0x10 + pipe;
+	check("pipes: each message on its own pipe",delivered);
+}
+
+int main(void)
+{
+	void (*checks[])(void) = { check_sync, check_pipes, check_rx_full, check_send_message, check_warm_init, check_frag, check_ack_payload, check_hop, check_arq, check_mesh, check_tdma, check_csma };
+	
+	for (uint8_t i = 0; i < sizeof(checks) / sizeof(checks[0]); i++)
+	{
+		if (!setup())
+		{
+			printf("Radio did not answer\n");
+			return 1;
+		}
+		checks[i]();
+	}
+	printf("%u failed\n",failures);
+	return failures;
+}
@@ -0,0 +1,140 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//
+//	CSMA_NODES nodes send 32 byte messages to a gateway whenever they have one, first straight
+//	away (ALOHA) and then with listen before talk. Messages that overlap on air collide and are
+//	lost. Load is average time between messages of one node in us. Main loops of the nodes take
+//	turns every 10us and sample the channel without blocking, so nodes sample at the same time as
+//	on real air: one that reads RPD within the 145us another one needs from sample to carrier
+//	(CE pulse, TX settling) does not see it.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+#include "nrf24l01.h"
+#include "nrf24l01-csma.h"
+#include "timer.h"
+
+#define CSMA_NODES	6
+
+static sim_radio chips[CSMA_NODES + 1];
+static nrf24_t radios[CSMA_NODES + 1] =
+{
+	NRF24_RADIO(chips[0].ce, 0, chips[0].csn, 0, 0),
+	NRF24_RADIO(chips[1].ce, 0, chips[1].csn, 0, 1),
+	NRF24_RADIO(chips[2].ce, 0, chips[2].csn, 0, 1),
+	NRF24_RADIO(chips[3].ce, 0, chips[3].csn, 0, 1),
+	NRF24_RADIO(chips[4].ce, 0, chips[4].csn, 0, 1),
+	NRF24_RADIO(chips[5].ce, 0, chips[5].csn, 0, 1),
+	NRF24_RADIO(chips[6].ce, 0, chips[6].csn, 0, 1)
+};
+static nrf24_csma csma[CSMA_NODES + 1];
+
+static void isr0(void) { nrf24_irq(&radios[0]); }
+static void isr1(void) { nrf24_irq(&radios[1]); }
+static void isr2(void) { nrf24_irq(&radios[2]); }
+static void isr3(void) { nrf24_irq(&radios[3]); }
+static void isr4(void) { nrf24_irq(&radios[4]); }
+static void isr5(void) { nrf24_irq(&radios[5]); }
+static void isr6(void) { nrf24_irq(&radios[6]); }
+
+static void run(bool listen, uint32_t gap, uint32_t duration)
+{
+	void (*isr[CSMA_NODES + 1])(void) = { isr0, isr1, isr2, isr3, isr4, isr5, isr6 };
+	uint32_t ready[CSMA_NODES + 1];
+	uint32_t offered = 0, sent = 0, received = 0, busy = 0, dropped = 0, backoff = 0;
+	uint8_t message[32];
+	
+	sim_init(1);
+	srand(1);
+	for (uint8_t i = 0; i <= CSMA_NODES; i++)
+	{
+		chips[i].isr = isr[i];
+		sim_add(&chips[i]);
+		radios[i].tx_busy = false;
+		if (nrf24_init(&radios[i]) != NRF24_OK)
+		{
+			printf("Radio did not answer\n");
+			exit(1);
+		}
+		nrf24_csma_init(&csma[i],&radios[i],i * 7919);
+		ready[i] = rand() % gap;
+	}
+	nrf24_start_listening(&radios[0]);
+	
+	while (timer_micros() < duration)
+	{
+		// Gateway counts what got through
+		while (nrf24_peek(&radios[0]))
+		{
+			received++;
+			nrf24_release(&radios[0]);
+		}
+		
+		for (uint8_t i = 1; i <= CSMA_NODES; i++)
+		{
+			nrf24_csma_poll(&csma[i]);
+			
+			// Next message comes 0 - 2 * gap after previous one was handed over
+			if (timer_micros() < ready[i] || radios[i].tx_busy || csma[i].length) continue;
+			message[0] = i;
+			offered++;
+			if (listen) nrf24_csma_send(&csma[i],message,sizeof(message));
+			else
+			{
+				nrf24_send_async(&radios[i],message,sizeof(message),0);
+				sent++;
+			}
+			ready[i] = timer_micros() + rand() % (2 * gap);
+		}
+		hal_delay_us(10);
+	}
+	
+	for (uint8_t i = 1; i <= CSMA_NODES; i++)
+	{
+		sent += csma[i].stats.sent;
+		busy += csma[i].stats.busy;
+		dropped += csma[i].stats.dropped;
+		backoff += csma[i].stats.backoff;
+	}
+	printf("%-6s %8lu %8lu %8lu %8lu %8lu %8lu %9.1f %10.1f %10lu\n",listen ? "csma" : "aloha",(unsigned long)gap,
+		(unsigned long)offered,(unsigned long)sent,(unsigned long)received,(unsigned long)busy,(unsigned long)dropped,
+		sent ? 100.0 * (sent - received) / sent : 0.0,received * 32 * 8 / (duration / 1000.0),
+		(unsigned long)(offered ? backoff / offered : 0));
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t duration = argc > 1 ? atol(argv[1]) * 1000UL : 2000000UL;
+	uint32_t gaps[] = { 20000, 5000, 2000, 1000 };
+	
+	printf("%-6s %8s %8s %8s %8s %8s %8s %9s %10s %10s\n","mode","gap_us","offered","sent","received","busy","dropped","lost_%","kbps","backoff_us");
+	for (uint8_t i = 0; i < sizeof(gaps) / sizeof(gaps[0]); i++)
+	{
+		run(false,gaps[i],duration);
+		run(true,gaps[i],duration);
+	}
+	return 0;
+}
@@ -0,0 +1,106 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//
+//	Node sends numbered messages to gateway over simulated air, gateway takes them
+//	from nrf24_irq() like on the MCU. Prints what arrived and link statistics, last driver
+//	events are dumped into trace file when one is given (decode with ./trace).
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+#include "nrf24l01.h"
+#include "nrf24l01-trace.h"
+
+static sim_radio gateway_chip, node_chip;
+static nrf24_t gateway = NRF24_RADIO(gateway_chip.ce, 0, gateway_chip.csn, 0, 0);
+static nrf24_t node = NRF24_RADIO(node_chip.ce, 0, node_chip.csn, 0, 1);
+
+static void gateway_isr(void)
+{
+	nrf24_irq(&gateway);
+}
+
+static void node_isr(void)
+{
+	nrf24_irq(&node);
+}
+
+static FILE *trace_file;
+
+static void trace_put(uint8_t byte)
+{
+	fputc(byte,trace_file);
+}
+
+int main(int argc, char **argv)
+{
+	uint16_t count = argc > 1 ? atoi(argv[1]) : 100;
+	double loss = argc > 2 ? atof(argv[2]) : 0;
+	uint16_t received = 0;
+	uint8_t message[32];
+	nrf24_frame frame;
+	nrf24_stats stats;
+	uint64_t start;
+	
+	sim_init(1);
+	sim_set_loss(loss);
+	gateway_chip.isr = gateway_isr;
+	node_chip.isr = node_isr;
+	sim_add(&gateway_chip);
+	sim_add(&node_chip);
+	
+	if (nrf24_init(&gateway) != NRF24_OK || nrf24_init(&node) != NRF24_OK)
+	{
+		printf("Radio did not answer\n");
+		return 1;
+	}
+	nrf24_start_listening(&gateway);
+	
+	start = sim_time();
+	for (uint16_t i = 0; i < count; i++)
+	{
+		for (uint8_t j = 0; j < sizeof(message); j++) message[j] = i + j;
+		nrf24_send(&node,message,sizeof(message));
+		while (nrf24_receive(&gateway,&frame)) received++;
+	}
+	hal_delay_ms(1);
+	while (nrf24_receive(&gateway,&frame)) received++;
+	
+	nrf24_get_stats(&node,&stats);
+	printf("sent %u received %u in %.3f ms\n",count,received,(sim_time() - start) / 1e6);
+	printf("node: max_rt %lu retransmits %lu spi_bytes %lu\n",(unsigned long)stats.max_rt,(unsigned long)stats.retransmits,(unsigned long)stats.spi_bytes);
+	printf("send latency (us, log2 buckets):");
+	for (uint8_t i = 0; i < NRF24_LATENCY_BUCKETS; i++) printf(" %u",stats.latency[i]);
+	printf("\n");
+	
+	if (argc > 3)
+	{
+		trace_file = fopen(argv[3],"wb");
+		if (!trace_file) return 1;
+		printf("%u trace records in %s\n",nrf24_trace_dump(trace_put),argv[3]);
+		fclose(trace_file);
+	}
+	return 0;
+}
@@ -0,0 +1,124 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//
+//	Battery node 2 is out of range of gateway 0 and reaches it over mains-powered relay 1.
+//	Node has fixed default route to relay, relay to gateway, gateway learns way back from
+//	node's messages and answers every one. Main loops of the three MCUs take turns.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+#include "nrf24l01.h"
+#include "nrf24l01-mesh.h"
+
+#define MESH_NODES	3
+
+static sim_radio chips[MESH_NODES];
+static nrf24_t radios[MESH_NODES] =
+{
+	NRF24_RADIO(chips[0].ce, 0, chips[0].csn, 0, 0),
+	NRF24_RADIO(chips[1].ce, 0, chips[1].csn, 0, 0),
+	NRF24_RADIO(chips[2].ce, 0, chips[2].csn, 0, 0)
+};
+static nrf24_mesh mesh[MESH_NODES];
+static uint16_t answers;
+
+static void isr0(void) { nrf24_irq(&radios[0]); }
+static void isr1(void) { nrf24_irq(&radios[1]); }
+static void isr2(void) { nrf24_irq(&radios[2]); }
+
+//	Main loop of one node: messages for it are handled, others relayed from the RX queue
+static void node_loop(uint8_t id)
+{
+	nrf24_frame *frame;
+	
+	while ((frame = nrf24_peek(&radios[id])))
+	{
+		if (nrf24_mesh_receive(&mesh[id],frame))
+		{
+			if (id == MESH_GATEWAY) nrf24_mesh_send(&mesh[id],mesh[id].source,mesh[id].data,mesh[id].length);
+			else answers++;
+		}
+		nrf24_release(&radios[id]);
+	}
+}
+
+static void print_routes(nrf24_mesh *node)
+{
+	printf("node %u: delivered %lu relayed %lu duplicates %u expired %u no_route %u failed %u\n",node->id,
+		(unsigned long)node->stats.delivered,(unsigned long)node->stats.relayed,node->stats.duplicates,
+		node->stats.expired,node->stats.no_route,node->stats.failed);
+	for (uint8_t i = 0; i < node->route_count; i++)
+	{
+		nrf24_route *route = &node->routes[i];
+		printf("  to %3u over %u, %u hops%s, sent %u failed %u, latency %u us\n",route->destination,route->next,
+			route->hops,route->fixed ? " (fixed)" : "",route->sent,route->failed,route->latency);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	uint16_t count = argc > 1 ? atoi(argv[1]) : 100;
+	double loss = argc > 2 ? atof(argv[2]) : 0;
+	void (*isr[MESH_NODES])(void) = { isr0, isr1, isr2 };
+	uint8_t reading[8];
+	uint16_t delivered = 0;
+	
+	sim_init(1);
+	sim_set_loss(loss);
+	for (uint8_t i = 0; i < MESH_NODES; i++)
+	{
+		chips[i].isr = isr[i];
+		sim_add(&chips[i]);
+	}
+	sim_set_range(&chips[0],&chips[2],false);
+	
+	for (uint8_t i = 0; i < MESH_NODES; i++)
+	{
+		if (nrf24_init(&radios[i]) != NRF24_OK)
+		{
+			printf("Radio did not answer\n");
+			return 1;
+		}
+		nrf24_mesh_init(&mesh[i],&radios[i],i,i != 2);
+		nrf24_start_listening(&radios[i]);
+	}
+	nrf24_mesh_route(&mesh[1],MESH_ANY,MESH_GATEWAY,1);
+	nrf24_mesh_route(&mesh[2],MESH_ANY,1,2);
+	
+	for (uint16_t i = 0; i < count; i++)
+	{
+		for (uint8_t j = 0; j < sizeof(reading); j++) reading[j] = i + j;
+		if (nrf24_mesh_send(&mesh[2],MESH_GATEWAY,reading,sizeof(reading)) == NRF24_OK) delivered++;
+		node_loop(1);
+		node_loop(0);
+		node_loop(1);
+		node_loop(2);
+	}
+	
+	printf("node 2 sent %u (%u to relay), %u answers came back in %.3f ms\n",count,delivered,answers,sim_time() / 1e6);
+	for (uint8_t i = 0; i < MESH_NODES; i++) print_routes(&mesh[i]);
+	return 0;
+}
@@ -0,0 +1,705 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdio.h>
+
+#include "sim.h"
+#include "spi.h"
+#include "timer.h"
+#include "nrf24l01-mnemonics.h"
+
+// Transmitter states
+#define SIM_IDLE		0
+#define SIM_SETTLE		1				// PLL settling before message goes on air
+#define SIM_AIR			2
+#define SIM_ACK			3				// Waiting for ACK or ARD to run out
+#define SIM_NEVER		UINT64_MAX
+
+// Timing from datasheet (ns)
+#define SIM_SETTLING	130000ULL		// Tstby2a, RX/TX settling
+#define SIM_POWER_UP	1500000ULL		// Tpd2stby
+#define SIM_RPD_DELAY	40000ULL		// RPD valid after settling + 40us
+#define SIM_SPI_BYTE	1000ULL			// SPI at F_CPU / 2 = 8MHz, ~1us per byte with SPDR handling
+
+static sim_radio *radios[SIM_RADIOS];
+static uint8_t radio_count;
+static uint64_t now;
+static uint8_t interrupts = 1;
+static uint32_t random_state = 1;
+static double air_loss;
+static double noise[126];
+static void (*idle_task)(void);
+static uint8_t unreachable[SIM_RADIOS];		// Bit n: radio with index n is out of range
+
+uint32_t sim_random(void)
+{
+	// xorshift32
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+	return random_state;
+}
+
+static bool sim_lost(uint8_t channel)
+{
+	double loss = air_loss + noise[channel];
+	return loss > 0 && sim_random() / 4294967296.0 < loss;
+}
+
+void sim_init(uint32_t seed)
+{
+	radio_count = 0;
+	now = 0;
+	interrupts = 1;
+	random_state = seed ? seed : 1;
+	air_loss = 0;
+	memset(noise,0,sizeof(noise));
+	idle_task = 0;
+	memset(unreachable,0,sizeof(unreachable));
+}
+
+void sim_set_loss(double loss)
+{
+	air_loss = loss;
+}
+
+void sim_set_idle(void (*task)(void))
+{
+	idle_task = task;
+}
+
+void sim_set_noise(uint8_t channel, double loss)
+{
+	if (channel < 126) noise[channel] = loss;
+}
+
+uint64_t sim_time(void)
+{
+	return now;
+}
+
+void sim_add(sim_radio *radio)
+{
+	void (*isr)(void) = radio->isr;
+	
+	// Power on reset values
+	memset(radio,0,sizeof(sim_radio));
+	radio->isr = isr;
+	radio->csn = 1;
+	radio->reg[CONFIG] = 0x08;
+	radio->reg[EN_AA] = 0x3F;
+	radio->reg[EN_RXADDR] = 0x03;
+	radio->reg[SETUP_AW] = 0x03;
+	radio->reg[SETUP_RETR] = 0x03;
+	radio->reg[RF_CH] = 0x02;
+	radio->reg[RF_SETUP] = 0x0E;
+	radio->reg[RX_ADDR_P2] = 0xC3;
+	radio->reg[RX_ADDR_P3] = 0xC4;
+	radio->reg[RX_ADDR_P4] = 0xC5;
+	radio->reg[RX_ADDR_P5] = 0xC6;
+	memset(radio->rx_addr_p0,0xE7,5);
+	memset(radio->rx_addr_p1,0xC2,5);
+	memset(radio->tx_addr,0xE7,5);
+	radio->event = SIM_NEVER;
+	
+	if (radio_count < SIM_RADIOS) radios[radio_count++] = radio;
+}
+
+static uint8_t sim_index(sim_radio *radio)
+{
+	for (uint8_t i = 0; i < radio_count; i++)
+	{
+		if (radios[i] == radio) return i;
+	}
+	return SIM_RADIOS;
+}
+
+void sim_set_range(sim_radio *a, sim_radio *b, bool reachable)
+{
+	uint8_t i = sim_index(a), j = sim_index(b);
+	
+	if (i == SIM_RADIOS || j == SIM_RADIOS) return;
+	if (reachable)
+	{
+		unreachable[i] &= ~(1 << j);
+		unreachable[j] &= ~(1 << i);
+	}
+	else
+	{
+		unreachable[i] |= (1 << j);
+		unreachable[j] |= (1 << i);
+	}
+}
+
+static bool sim_hears(sim_radio *receiver, sim_radio *transmitter)
+{
+	uint8_t i = sim_index(receiver), j = sim_index(transmitter);
+	return i == SIM_RADIOS || j == SIM_RADIOS || !(unreachable[i] & (1 << j));
+}
+
+static sim_radio * sim_find(volatile uint8_t *port)
+{
+	for (uint8_t i = 0; i < radio_count; i++)
+	{
+		if (port == &radios[i]->ce || port == &radios[i]->csn) return radios[i];
+	}
+	return 0;
+}
+
+// ---- Interrupts ----
+
+static void sim_irq(sim_radio *radio)
+{
+	// IRQ pin is low while any flag not masked in CONFIG is set, ISR runs on falling edge
+	bool line = (radio->reg[STATUS] & ~radio->reg[CONFIG] & 0x70) != 0;
+	if (line && !radio->irq) radio->irq_pending = true;
+	radio->irq = line;
+}
+
+static void sim_deliver(void)
+{
+	bool again = true;
+	
+	// ISR runs with interrupts disabled, edges during it are taken after it returns
+	while (interrupts && again)
+	{
+		again = false;
+		for (uint8_t i = 0; i < radio_count; i++)
+		{
+			if (!radios[i]->irq_pending) continue;
+			radios[i]->irq_pending = false;
+			if (!radios[i]->isr) continue;
+			interrupts = 0;
+			radios[i]->isr();
+			interrupts = 1;
+			again = true;
+		}
+	}
+}
+
+uint8_t sim_cli(void)
+{
+	uint8_t enabled = interrupts;
+	interrupts = 0;
+	return enabled;
+}
+
+void sim_restore(uint8_t enabled)
+{
+	interrupts = enabled;
+	sim_deliver();
+}
+
+// ---- Radio model ----
+
+static uint32_t sim_rate(sim_radio *radio)
+{
+	if (radio->reg[RF_SETUP] & (1 << RF_DR_LOW)) return 250000;
+	if (radio->reg[RF_SETUP] & (1 << RF_DR_HIGH)) return 2000000;
+	return 1000000;
+}
+
+static uint64_t sim_airtime(sim_radio *radio, uint8_t length)
+{
+	// Preamble, address, 9 bit packet control field, payload and CRC
+	uint32_t rate = sim_rate(radio);
+	uint8_t crc = (radio->reg[CONFIG] & (1 << EN_CRC)) ? ((radio->reg[CONFIG] & (1 << CRC0)) ? 2 : 1) : 0;
+	uint32_t bits = 8 * ((rate == 2000000 ? 2 : 1) + (radio->reg[SETUP_AW] + 2) + length + crc) + 9;
+	return (uint64_t)bits * 1000000000ULL / rate;
+}
+
+static bool sim_dynamic(sim_radio *radio, uint8_t pipe)
+{
+	return (radio->reg[FEATURE] & (1 << EN_DPL)) && (radio->reg[DYNPD] & (1 << pipe));
+}
+
+static sim_payload * sim_tx_head(sim_radio *radio)
+{
+	// ACK payloads wait in the same FIFO, PTX sends head whatever it is (like the chip)
+	return radio->tx_count ? &radio->tx_fifo[0] : 0;
+}
+
+static void sim_tx_remove(sim_radio *radio, sim_payload *payload)
+{
+	uint8_t index = payload - radio->tx_fifo;
+	memmove(payload,payload + 1,(radio->tx_count - index - 1) * sizeof(sim_payload));
+	radio->tx_count--;
+}
+
+static uint8_t sim_status(sim_radio *radio)
+{
+	return (radio->reg[STATUS] & 0x70) | ((radio->rx_count ? radio->rx_fifo[0].pipe : 7) << RX_P_NO) |
+		((radio->tx_count == 3) << TX_FULL);
+}
+
+static void sim_start_tx(sim_radio *radio)
+{
+	// PTX with CE high (or just pulsed) sends head of TX FIFO, MAX_RT stops it until cleared
+	if (radio->tx_state != SIM_IDLE || !radio->ce_level) return;
+	if ((radio->reg[CONFIG] & ((1 << PWR_UP) | (1 << PRIM_RX))) != (1 << PWR_UP)) return;
+	if ((radio->reg[STATUS] & (1 << MAX_RT)) || !sim_tx_head(radio)) return;
+	
+	radio->tx_state = SIM_SETTLE;
+	radio->event = (now > radio->ready ? now : radio->ready) + SIM_SETTLING;
+	radio->arc_cnt = 0;
+	radio->pid++;
+}
+
+static void sim_mode(sim_radio *radio)
+{
+	bool rx = (radio->reg[CONFIG] & (1 << PWR_UP)) && (radio->reg[CONFIG] & (1 << PRIM_RX)) && radio->ce_level;
+	
+	if (rx && !radio->listening) radio->rx_since = now > radio->ready ? now : radio->ready;
+	if (!rx) radio->rpd = false;
+	radio->listening = rx;
+	
+	if (!(radio->reg[CONFIG] & (1 << PWR_UP)))
+	{
+		radio->tx_state = SIM_IDLE;
+		radio->event = SIM_NEVER;
+	}
+	sim_start_tx(radio);
+}
+
+static bool sim_settled(sim_radio *radio, uint64_t since)
+{
+	return radio->listening && radio->rx_since + SIM_SETTLING <= since;
+}
+
+static int8_t sim_match(sim_radio *radio, const uint8_t *address)
+{
+	uint8_t width = radio->reg[SETUP_AW] + 2;
+	
+	for (uint8_t pipe = 0; pipe < 6; pipe++)
+	{
+		if (!(radio->reg[EN_RXADDR] & (1 << pipe))) continue;
+		if (pipe == 0 && !memcmp(radio->rx_addr_p0,address,width)) return 0;
+		if (pipe == 1 && !memcmp(radio->rx_addr_p1,address,width)) return 1;
+		// Pipes 2 - 5 share all but LSB with pipe 1
+		if (pipe > 1 && address[0] == radio->reg[RX_ADDR_P0 + pipe] && !memcmp(&radio->rx_addr_p1[1],&address[1],width - 1)) return pipe;
+	}
+	return -1;
+}
+
+static bool sim_collision(sim_radio *radio)
+{
+	for (uint8_t i = 0; i < radio_count; i++)
+	{
+		sim_radio *other = radios[i];
+		if (other == radio || other->air_channel != radio->air_channel) continue;
+		if (other->air_start < radio->air_end && other->air_end > radio->air_start) return true;
+	}
+	return false;
+}
+
+static void sim_receive(sim_radio *radio, sim_payload *payload, bool noack)
+{
+	bool collision = sim_collision(radio);
+	uint16_t sum;
+	
+	radio->acked = false;
+	radio->ack_payload.length = 0;
+	
+	for (uint8_t i = 0; i < radio_count; i++)
+	{
+		sim_radio *receiver = radios[i];
+		int8_t pipe;
+		bool ack;
+		
+		// Has to listen on same channel and data rate for the whole message
+		if (receiver == radio || !sim_settled(receiver,radio->air_start) || !sim_hears(receiver,radio)) continue;
+		if (receiver->reg[RF_CH] != radio->air_channel || sim_rate(receiver) != sim_rate(radio)) continue;
+		pipe = sim_match(receiver,radio->tx_addr);
+		if (pipe < 0 || collision || sim_lost(radio->air_channel)) continue;
+		
+		// Payload length has to agree
+		if (sim_dynamic(receiver,pipe) != sim_dynamic(radio,0)) continue;
+		if (!sim_dynamic(receiver,pipe) && receiver->reg[RX_PW_P0 + pipe] != payload->length) continue;
+		
+		// RX FIFO full: message is dropped and not acknowledged
+		ack = !noack && (receiver->reg[EN_AA] & (1 << pipe));
+		sum = payload->length;
+		for (uint8_t j = 0; j < payload->length; j++) sum = (sum << 1 | sum >> 15) ^ payload->data[j];
+		if (ack && receiver->last_pid[pipe] == radio->pid && receiver->last_sum[pipe] == sum)
+		{
+			// Retransmit of message that was received but ACK got lost, acknowledge again
+		}
+		else
+		{
+			if (receiver->rx_count == 3) continue;
+			receiver->rx_fifo[receiver->rx_count] = *payload;
+			receiver->rx_fifo[receiver->rx_count++].pipe = pipe;
+			receiver->reg[STATUS] |= (1 << RX_DR);
+			receiver->last_pid[pipe] = radio->pid;
+			receiver->last_sum[pipe] = sum;
+			sim_irq(receiver);
+		}
+		
+		// First receiver answers, ACK payload for the pipe goes with it
+		if (!ack || radio->acked) continue;
+		if (receiver->reg[FEATURE] & (1 << EN_ACK_PAY))
+		{
+			for (uint8_t j = 0; j < receiver->tx_count; j++)
+			{
+				if (!receiver->tx_fifo[j].ack || receiver->tx_fifo[j].pipe != pipe) continue;
+				radio->ack_payload = receiver->tx_fifo[j];
+				sim_tx_remove(receiver,&receiver->tx_fifo[j]);
+				break;
+			}
+		}
+		radio->acked = !sim_lost(radio->air_channel);
+	}
+}
+
+static void sim_air(sim_radio *radio)
+{
+	sim_payload *payload = sim_tx_head(radio);
+	
+	radio->tx_state = SIM_AIR;
+	radio->air_channel = radio->reg[RF_CH];
+	radio->air_start = now;
+	radio->air_end = now + sim_airtime(radio,payload->length);
+	radio->event = radio->air_end;
+	
+	// Carrier shows in RPD of radios listening on the channel
+	for (uint8_t i = 0; i < radio_count; i++)
+	{
+		if (radios[i] != radio && radios[i]->reg[RF_CH] == radio->air_channel && sim_settled(radios[i],now) && sim_hears(radios[i],radio)) radios[i]->rpd = true;
+	}
+}
+
+static void sim_tx_done(sim_radio *radio, sim_payload *payload)
+{
+	sim_tx_remove(radio,payload);
+	radio->reg[STATUS] |= (1 << TX_DS);
+	
+	// ACK payload lands in RX FIFO as pipe 0 message
+	if (radio->ack_payload.length && radio->rx_count < 3)
+	{
+		radio->rx_fifo[radio->rx_count] = radio->ack_payload;
+		radio->rx_fifo[radio->rx_count++].pipe = 0;
+		radio->reg[STATUS] |= (1 << RX_DR);
+	}
+	radio->tx_state = SIM_IDLE;
+	radio->event = SIM_NEVER;
+	sim_start_tx(radio);
+}
+
+static void sim_step(sim_radio *radio)
+{
+	sim_payload *payload = sim_tx_head(radio);
+	uint64_t ack_time, delay;
+	bool noack;
+	
+	// Payload was flushed while sending
+	if (!payload && radio->tx_state != SIM_IDLE)
+	{
+		radio->tx_state = SIM_IDLE;
+		radio->event = SIM_NEVER;
+		return;
+	}
+	
+	switch (radio->tx_state)
+	{
+		case SIM_SETTLE:
+		sim_air(radio);
+		break;
+		
+		case SIM_AIR:
+		noack = payload->noack || !(radio->reg[EN_AA] & (1 << ENAA_P0));
+		sim_receive(radio,payload,noack);
+		if (noack)
+		{
+			sim_tx_done(radio,payload);
+			break;
+		}
+		// ACK has to arrive within ARD, otherwise it is missed
+		ack_time = SIM_SETTLING + sim_airtime(radio,radio->ack_payload.length);
+		delay = 250000ULL * ((radio->reg[SETUP_RETR] >> ARD) + 1);
+		if (ack_time > delay) radio->acked = false;
+		radio->tx_state = SIM_ACK;
+		radio->event = now + (radio->acked ? ack_time : delay);
+		break;
+		
+		case SIM_ACK:
+		if (radio->acked) sim_tx_done(radio,payload);
+		else if (radio->arc_cnt < ((radio->reg[SETUP_RETR] >> ARC) & 0x0F))
+		{
+			radio->arc_cnt++;
+			sim_air(radio);
+		}
+		else
+		{
+			radio->reg[STATUS] |= (1 << MAX_RT);
+			if (radio->plos_cnt < 15) radio->plos_cnt++;
+			radio->tx_state = SIM_IDLE;
+			radio->event = SIM_NEVER;
+		}
+		break;
+	}
+	sim_irq(radio);
+}
+
+void sim_run(uint64_t ns)
+{
+	uint64_t target = now + ns;
+	sim_radio *next;
+	
+	// Radio events in time order, ISRs may run in between and move time further
+	while (1)
+	{
+		next = 0;
+		for (uint8_t i = 0; i < radio_count; i++)
+		{
+			if (radios[i]->event <= target && (!next || radios[i]->event < next->event)) next = radios[i];
+		}
+		if (!next) break;
+		if (next->event > now) now = next->event;
+		sim_step(next);
+		sim_deliver();
+	}
+	if (now < target) now = target;
+	sim_deliver();
+}
+
+// ---- SPI commands ----
+
+// Carrier of a message still on air, radio has to listen 40us after settling to see it
+static bool sim_carrier(sim_radio *radio)
+{
+	if (!sim_settled(radio,now - SIM_RPD_DELAY)) return false;
+	for (uint8_t i = 0; i < radio_count; i++)
+	{
+		sim_radio *other = radios[i];
+		if (other != radio && other->tx_state == SIM_AIR && other->air_channel == radio->reg[RF_CH] && sim_hears(radio,other)) return true;
+	}
+	return false;
+}
+
+static uint8_t sim_read_register(sim_radio *radio, uint8_t address, uint8_t index)
+{
+	switch (address)
+	{
+		case RX_ADDR_P0: return radio->rx_addr_p0[index % 5];
+		case RX_ADDR_P1: return radio->rx_addr_p1[index % 5];
+		case TX_ADDR: return radio->tx_addr[index % 5];
+		case STATUS: return sim_status(radio);
+		case OBSERVE_TX: return (radio->plos_cnt << PLOS_CNT) | (radio->arc_cnt << ARC_CNT);
+		case RPD:
+		return radio->rpd || sim_carrier(radio) || (noise[radio->reg[RF_CH]] > 0 && sim_settled(radio,now - SIM_RPD_DELAY));
+		case FIFO_STATUS:
+		return ((radio->tx_count == 3) << FIFO_FULL) | ((radio->tx_count == 0) << TX_EMPTY) |
+			((radio->rx_count == 3) << RX_FULL) | ((radio->rx_count == 0) << RX_EMPTY);
+	}
+	return address < sizeof(radio->reg) ? radio->reg[address] : 0;
+}
+
+static void sim_write_register(sim_radio *radio, uint8_t address, const uint8_t *data, uint8_t length)
+{
+	uint8_t value = length ? data[0] : 0xFF;
+	
+	switch (address)
+	{
+		case RX_ADDR_P0: memcpy(radio->rx_addr_p0,data,length < 5 ? length : 5); return;
+		case RX_ADDR_P1: memcpy(radio->rx_addr_p1,data,length < 5 ? length : 5); return;
+		case TX_ADDR: memcpy(radio->tx_addr,data,length < 5 ? length : 5); return;
+		case OBSERVE_TX: case RPD: case FIFO_STATUS: return;
+		case STATUS:
+		// Flags are cleared by writing 1, TX continues once MAX_RT is gone
+		radio->reg[STATUS] &= ~(value & 0x70);
+		sim_start_tx(radio);
+		return;
+		case RF_CH:
+		radio->plos_cnt = 0;
+		radio->reg[RF_CH] = value & 0x7F;
+		return;
+		case CONFIG:
+		if ((value & (1 << PWR_UP)) && !(radio->reg[CONFIG] & (1 << PWR_UP))) radio->ready = now + SIM_POWER_UP;
+		radio->reg[CONFIG] = value;
+		sim_mode(radio);
+		return;
+	}
+	if (address < sizeof(radio->reg)) radio->reg[address] = value;
+}
+
+static void sim_command(sim_radio *radio, uint8_t command, const uint8_t *tx, uint8_t *rx, uint8_t length)
+{
+	uint8_t data[32];
+	sim_payload *payload;
+	
+	// NULL 'tx' clocks out 0xFF
+	if (length > 32) length = 32;
+	for (uint8_t i = 0; i < length; i++) data[i] = tx ? tx[i] : 0xFF;
+	memset(data + length,0xFF,sizeof(data) - length);
+	
+	if ((command & ~REGISTER_MASK) == R_REGISTER)
+	{
+		for (uint8_t i = 0; i < length; i++) data[i] = sim_read_register(radio,command & REGISTER_MASK,i);
+	}
+	else if ((command & ~REGISTER_MASK) == W_REGISTER) sim_write_register(radio,command & REGISTER_MASK,data,length);
+	else if (command == R_RX_PL_WID)
+	{
+		// Defined only with dynamic payload on the pipe, model gives 0 otherwise
+		data[0] = radio->rx_count && sim_dynamic(radio,radio->rx_fifo[0].pipe) ? radio->rx_fifo[0].length : 0;
+	}
+	else if (command == R_RX_PAYLOAD)
+	{
+		if (radio->rx_count)
+		{
+			memcpy(data,radio->rx_fifo[0].data,length);
+			memmove(&radio->rx_fifo[0],&radio->rx_fifo[1],--radio->rx_count * sizeof(sim_payload));
+		}
+	}
+	else if (command == W_TX_PAYLOAD || command == W_TX_PAYLOAD_NOACK || (command & ~ACK_PAYLOAD_MASK) == W_ACK_PAYLOAD)
+	{
+		if (radio->tx_count < 3)
+		{
+			payload = &radio->tx_fifo[radio->tx_count++];
+			payload->length = length;
+			payload->noack = command == W_TX_PAYLOAD_NOACK && (radio->reg[FEATURE] & (1 << EN_DYN_ACK));
+			payload->ack = (command & ~ACK_PAYLOAD_MASK) == W_ACK_PAYLOAD;
+			payload->pipe = command & ACK_PAYLOAD_MASK;
+			memcpy(payload->data,data,length);
+			sim_start_tx(radio);
+		}
+	}
+	else if (command == FLUSH_TX) radio->tx_count = 0;
+	else if (command == FLUSH_RX) radio->rx_count = 0;
+	
+	if (rx) memcpy(rx,data,length);
+	sim_irq(radio);
+}
+
+// ---- HAL, SPI and timer of the host build ----
+
+void hal_pin_output(volatile uint8_t *port, uint8_t mask)
+{
+}
+
+static void sim_pin(volatile uint8_t *port)
+{
+	sim_radio *radio = sim_find(port);
+	bool level;
+	
+	if (!radio || port != &radio->ce) return;
+	level = radio->ce != 0;
+	if (level == radio->ce_level) return;
+	radio->ce_level = level;
+	sim_mode(radio);
+}
+
+void hal_pin_high(volatile uint8_t *port, uint8_t mask)
+{
+	*port |= mask;
+	sim_pin(port);
+}
+
+void hal_pin_low(volatile uint8_t *port, uint8_t mask)
+{
+	*port &= ~mask;
+	sim_pin(port);
+}
+
+void hal_irq_init(uint8_t irq)
+{
+}
+
+void hal_delay_us(double us)
+{
+	sim_run(us * 1000);
+}
+
+void hal_delay_ms(double ms)
+{
+	sim_run(ms * 1000000);
+}
+
+void hal_idle(void)
+{
+	static bool running;
+	
+	sim_run(SIM_SPI_BYTE);
+	
+	// Other MCU gets to run its main loop while this one waits, but not from inside itself
+	if (idle_task && !running)
+	{
+		running = true;
+		idle_task();
+		running = false;
+	}
+}
+
+void spi_master_init(void)
+{
+}
+
+void spi_submit(struct spi_transfer *transfer)
+{
+	sim_radio *radio = sim_find(transfer->csn_port);
+	uint8_t enabled = sim_cli();
+	uint8_t length = transfer->length + transfer->pad;
+	uint8_t tx[64], rx[64];
+	
+	// Chip sees one transaction, padding zeros follow caller's bytes
+	if (transfer->tx) memcpy(tx,transfer->tx,transfer->length);
+	else memset(tx,0xFF,transfer->length);
+	memset(tx + transfer->length,0,transfer->pad);
+	
+	// Transfers run right away, STATUS is clocked out with command byte
+	transfer->status = radio ? sim_status(radio) : 0xFF;
+	sim_run((1 + length) * SIM_SPI_BYTE);
+	if (radio) sim_command(radio,transfer->command,transfer->tx || transfer->pad ? tx : 0,transfer->rx ? rx : 0,length);
+	else memset(rx,0xFF,length);
+	if (transfer->rx) memcpy(transfer->rx,rx,transfer->length);
+	transfer->done = 1;
+	if (transfer->complete) transfer->complete(transfer);
+	sim_restore(enabled);
+}
+
+void spi_wait(struct spi_transfer *transfer)
+{
+}
+
+uint8_t spi_busy(void)
+{
+	return 0;
+}
+
+void timer_init(void)
+{
+}
+
+uint32_t timer_millis(void)
+{
+	return now / 1000000ULL;
+}
+
+uint32_t timer_micros(void)
+{
+	return now / 1000ULL;
+}
+
+void timer_raw(uint16_t *millis, uint8_t *ticks)
+{
+	*millis = now / 1000000ULL;
+	*ticks = now % 1000000ULL / TIMER_TICK_NS;
+}
@@ -0,0 +1,124 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef _SIM_H
+#define _SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+//	Host build (-DNRF24_HOST): behavioural nRF24L01+ radios on a shared virtual "air".
+//	Model has register file, 3-deep TX/RX FIFOs, STATUS/FIFO_STATUS flags, auto-ACK with
+//	ACK payloads, ARD/ARC retransmits, OBSERVE_TX, RPD and IRQ pin. Time is virtual (ns) and
+//	only moves with SPI bytes, delays and idle waits, so runs are repeatable for given seed.
+
+//	MCU pieces used by the driver (see nrf24l01-hal.h)
+#define PROGMEM
+#define memcpy_P(destination, source, size)	memcpy((destination),(source),(size))
+#define pgm_read_byte(address)				(*(const uint8_t *)(address))
+#define PSTR(string)						(string)
+#define printf_P							printf
+
+//	Interrupts: ISR of a radio is called on falling edge of its IRQ pin unless disabled,
+//	then it runs when they are enabled again
+uint8_t sim_cli(void);
+void sim_restore(uint8_t enabled);
+static inline void sim_atomic_exit(const uint8_t *enabled) { sim_restore(*enabled); }
+#define cli()						((void)sim_cli())
+#define sei()						sim_restore(1)
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_BLOCK(type) \
+	for (uint8_t sim_sreg __attribute__((__cleanup__(sim_atomic_exit))) = sim_cli(), sim_todo = 1; sim_todo; sim_todo = 0)
+
+void hal_pin_output(volatile uint8_t *port, uint8_t mask);
+void hal_pin_high(volatile uint8_t *port, uint8_t mask);
+void hal_pin_low(volatile uint8_t *port, uint8_t mask);
+void hal_irq_init(uint8_t irq);
+void hal_delay_us(double us);
+void hal_delay_ms(double ms);
+void hal_idle(void);
+
+//	Simulated radio, 'ce' and 'csn' are its pin "ports" for NRF24_RADIO():
+//	nrf24_t radio = NRF24_RADIO(node.ce, 0, node.csn, 0, 0);
+#define SIM_RADIOS	8
+
+typedef struct
+{
+	uint8_t length;
+	uint8_t pipe;
+	bool noack;						// W_TX_PAYLOAD_NOACK
+	bool ack;						// W_ACK_PAYLOAD for 'pipe'
+	uint8_t data[32];
+} sim_payload;
+
+typedef struct
+{
+	volatile uint8_t ce;
+	volatile uint8_t csn;
+	void (*isr)(void);				// Like ISR(INT0_vect), should call nrf24_irq()
+	
+	// Chip state
+	uint8_t reg[0x1E];
+	uint8_t rx_addr_p0[5];
+	uint8_t rx_addr_p1[5];
+	uint8_t tx_addr[5];
+	sim_payload tx_fifo[3];
+	sim_payload rx_fifo[3];
+	uint8_t tx_count;
+	uint8_t rx_count;
+	uint8_t arc_cnt;
+	uint8_t plos_cnt;
+	bool rpd;
+	bool irq;						// IRQ pin is low
+	bool irq_pending;				// Falling edge while interrupts were disabled
+	bool ce_level;
+	bool listening;					// PWR_UP, PRIM_RX and CE high
+	uint64_t ready;					// Power up done (Tpd2stby)
+	uint64_t rx_since;				// Entered RX mode
+	
+	// Transmitter
+	uint8_t tx_state;
+	uint64_t event;					// Time of next TX state change
+	uint8_t pid;
+	uint64_t air_start;
+	uint64_t air_end;
+	uint8_t air_channel;
+	bool acked;
+	sim_payload ack_payload;		// ACK payload that comes back with ACK
+	
+	// Duplicate detection on receiver (PID and payload of last message per pipe)
+	uint8_t last_pid[6];
+	uint16_t last_sum[6];
+} sim_radio;
+
+void sim_init(uint32_t seed);
+void sim_add(sim_radio *radio);
+void sim_set_loss(double loss);					// Probability a message or ACK is lost on air
+void sim_set_noise(uint8_t channel, double loss);	// Interferer on channel, shows in RPD
+void sim_set_idle(void (*task)(void));			// Runs from hal_idle(), e.g. main loop of the other MCU
+void sim_set_range(sim_radio *a, sim_radio *b, bool reachable);	// After sim_add(), all radios hear each other by default
+uint64_t sim_time(void);						// ns
+void sim_run(uint64_t ns);
+uint32_t sim_random(void);
+
+#endif /*_SIM_H*/
@@ -0,0 +1,137 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//
+//	Gateway 0 and TDMA_NODES - 1 nodes. Node 1 has slot 0 given up front, the others ask for one
+//	in contention slot. Once it has a slot every node has a reading ready at a random time about
+//	every other superframe and sends it in its own slot, so latency does not include joining;
+//	the last node powers its radio down in between.
+//	Main loops of all MCUs take turns every 50 us.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+#include "nrf24l01.h"
+#include "nrf24l01-tdma.h"
+#include "timer.h"
+
+#define TDMA_NODES	6
+
+static sim_radio chips[TDMA_NODES];
+static nrf24_t radios[TDMA_NODES] =
+{
+	NRF24_RADIO(chips[0].ce, 0, chips[0].csn, 0, 0),
+	NRF24_RADIO(chips[1].ce, 0, chips[1].csn, 0, 0),
+	NRF24_RADIO(chips[2].ce, 0, chips[2].csn, 0, 0),
+	NRF24_RADIO(chips[3].ce, 0, chips[3].csn, 0, 0),
+	NRF24_RADIO(chips[4].ce, 0, chips[4].csn, 0, 0),
+	NRF24_RADIO(chips[5].ce, 0, chips[5].csn, 0, 0)
+};
+static nrf24_tdma tdma[TDMA_NODES];
+static uint32_t received[TDMA_NODES];
+static uint32_t sent[TDMA_NODES];
+static uint64_t latency[TDMA_NODES];
+
+static void isr0(void) { nrf24_irq(&radios[0]); }
+static void isr1(void) { nrf24_irq(&radios[1]); }
+static void isr2(void) { nrf24_irq(&radios[2]); }
+static void isr3(void) { nrf24_irq(&radios[3]); }
+static void isr4(void) { nrf24_irq(&radios[4]); }
+static void isr5(void) { nrf24_irq(&radios[5]); }
+
+//	Main loop of one MCU: beacons and joins go to scheduler, gateway counts readings by sender
+static void node_loop(uint8_t id)
+{
+	nrf24_frame *frame;
+	
+	nrf24_tdma_poll(&tdma[id]);
+	while ((frame = nrf24_peek(&radios[id])))
+	{
+		if (!nrf24_tdma_receive(&tdma[id],frame) && id == TDMA_GATEWAY && frame->data[0] < TDMA_NODES) received[frame->data[0]]++;
+		nrf24_release(&radios[id]);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	uint16_t frames = argc > 1 ? atoi(argv[1]) : 100;
+	double loss = argc > 2 ? atof(argv[2]) : 0;
+	void (*isr[TDMA_NODES])(void) = { isr0, isr1, isr2, isr3, isr4, isr5 };
+	uint32_t ready[TDMA_NODES];
+	uint8_t reading[8];
+	nrf24_stats stats;
+	
+	sim_init(1);
+	sim_set_loss(loss);
+	for (uint8_t i = 0; i < TDMA_NODES; i++)
+	{
+		chips[i].isr = isr[i];
+		sim_add(&chips[i]);
+	}
+	
+	for (uint8_t i = 0; i < TDMA_NODES; i++)
+	{
+		if (nrf24_init(&radios[i]) != NRF24_OK)
+		{
+			printf("Radio did not answer\n");
+			return 1;
+		}
+		nrf24_tdma_init(&tdma[i],&radios[i],i,i == TDMA_NODES - 1);
+		ready[i] = rand() % TDMA_FRAME;
+	}
+	nrf24_tdma_assign(&tdma[TDMA_GATEWAY],0,1);
+	
+	while (timer_micros() < (uint32_t)frames * TDMA_FRAME)
+	{
+		for (uint8_t i = 0; i < TDMA_NODES; i++)
+		{
+			// Reading waiting for slot is replaced by next one only after it is sent
+			if (i != TDMA_GATEWAY && timer_micros() >= ready[i] && tdma[i].slot != 0xFF && !tdma[i].pending_length)
+			{
+				if (sent[i]) latency[i] += tdma[i].latency;
+				reading[0] = i;
+				for (uint8_t j = 1; j < sizeof(reading); j++) reading[j] = sent[i] + j;
+				nrf24_tdma_send(&tdma[i],reading,sizeof(reading));
+				sent[i]++;
+				ready[i] += TDMA_FRAME + rand() % (2 * TDMA_FRAME);
+			}
+			node_loop(i);
+		}
+		hal_delay_us(50);
+	}
+	
+	printf("%u superframes of %lu us, %u slots\n",frames,(unsigned long)TDMA_FRAME,TDMA_SLOTS);
+	printf("slots:");
+	for (uint8_t i = 0; i < TDMA_SLOTS; i++) printf(" %u",tdma[TDMA_GATEWAY].owner[i]);
+	printf("\n");
+	for (uint8_t i = 1; i < TDMA_NODES; i++)
+	{
+		nrf24_get_stats(&radios[i],&stats);
+		printf("node %u: slot %3u, sent %lu, gateway got %lu, latency avg %lu max %lu us, radio off %lu ms%s\n",i,
+			tdma[i].slot,(unsigned long)sent[i],(unsigned long)received[i],
+			(unsigned long)(sent[i] > 1 ? latency[i] / (sent[i] - 1) : 0),(unsigned long)tdma[i].latency_max,
+			(unsigned long)stats.time[NRF24_TIME_POWERDOWN],tdma[i].low_power ? " (low power)" : "");
+	}
+	return 0;
+}
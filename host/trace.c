@@ -0,0 +1,148 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//
+//	Decodes trace frames dumped by nrf24_trace_dump() (see nrf24l01-trace.h) into a timeline,
+//	one line per record with time from previous one. Reads file given as argument or stdin,
+//	bytes between frames (e.g. printf output on the same UART) are skipped.
+//
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "nrf24l01.h"
+#include "nrf24l01-mnemonics.h"
+#include "nrf24l01-trace.h"
+
+static const char *states[] = { "?", "POWERUP", "POWERDOWN", "RECEIVE", "TRANSMIT", "STANDBY1", "STANDBY2" };
+static const char *modes[] = { "RX", "TX", "STANDBY", "POWERDOWN" };
+
+static uint16_t read16(const uint8_t *bytes)
+{
+	return bytes[0] | ((uint16_t)bytes[1] << 8);
+}
+
+static uint32_t read32(const uint8_t *bytes)
+{
+	return bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static void print_status(uint8_t status)
+{
+	printf("STATUS 0x%02x",status);
+	if (status & (1 << RX_DR)) printf(" RX_DR");
+	if (status & (1 << TX_DS)) printf(" TX_DS");
+	if (status & (1 << MAX_RT)) printf(" MAX_RT");
+	if (((status >> RX_P_NO) & 0x07) != 0x07) printf(" pipe %u",(status >> RX_P_NO) & 0x07);
+	if (status & (1 << TX_FULL)) printf(" TX_FULL");
+}
+
+static void print_record(uint8_t event, uint8_t value)
+{
+	switch (event & ~NRF24_TRACE_RADIO)
+	{
+		case NRF24_TRACE_STATE:
+		printf("state %s",value < 7 ? states[value] : states[0]);
+		break;
+		case NRF24_TRACE_MODE:
+		printf("mode %s",value < 4 ? modes[value] : "?");
+		break;
+		case NRF24_TRACE_CE:
+		printf("CE %s",value ? "high" : "low");
+		break;
+		case NRF24_TRACE_IRQ:
+		printf("IRQ ");
+		print_status(value);
+		break;
+		case NRF24_TRACE_STATUS:
+		printf("sent ");
+		print_status(value);
+		break;
+		case NRF24_TRACE_FLUSH:
+		printf("%s",value == FLUSH_RX ? "FLUSH_RX" : "FLUSH_TX");
+		break;
+		default:
+		printf("event %u value 0x%02x",event & ~NRF24_TRACE_RADIO,value);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	FILE *input = argc > 1 ? fopen(argv[1],"rb") : stdin;
+	uint8_t frame[NRF24_TRACE_HEADER + 255 * NRF24_TRACE_RECORD + 1];
+	uint8_t sum, count;
+	uint32_t dumped, millis, time, previous;
+	uint16_t tick_ns;
+	unsigned frames = 0;
+	size_t length;
+	int c, last = EOF;
+	
+	if (!input)
+	{
+		perror(argv[1]);
+		return 2;
+	}
+	
+	while ((c = fgetc(input)) != EOF)
+	{
+		// Frame starts after sync bytes
+		if (last != NRF24_TRACE_SYNC1 || c != NRF24_TRACE_SYNC2)
+		{
+			last = c;
+			continue;
+		}
+		last = EOF;
+		
+		if (fread(frame,1,NRF24_TRACE_HEADER,input) != NRF24_TRACE_HEADER) break;
+		count = frame[0];
+		length = NRF24_TRACE_HEADER + (size_t)count * NRF24_TRACE_RECORD + 1;
+		if (fread(frame + NRF24_TRACE_HEADER,1,length - NRF24_TRACE_HEADER,input) != length - NRF24_TRACE_HEADER) break;
+		
+		sum = 0;
+		for (size_t i = 0; i < length - 1; i++) sum += frame[i];
+		if (sum != frame[length - 1])
+		{
+			fprintf(stderr,"Frame with %u records has bad checksum, skipped\n",count);
+			continue;
+		}
+		
+		dumped = read32(&frame[1]);
+		tick_ns = read16(&frame[5]);
+		printf("frame %u: %u records, dumped at %lu ms\n",++frames,count,(unsigned long)dumped);
+		printf("%12s %10s radio event\n","time_us","delta_us");
+		for (uint8_t i = 0; i < count; i++)
+		{
+			const uint8_t *record = &frame[NRF24_TRACE_HEADER + i * NRF24_TRACE_RECORD];
+			
+			// Record keeps low 16 bits of ms, rest comes from dump time
+			millis = dumped - (uint16_t)((uint16_t)dumped - read16(record));
+			time = millis * 1000 + record[2] * tick_ns / 1000;
+			printf("%12lu %+10ld %5u ",(unsigned long)time,i ? (long)(time - previous) : 0L,(record[3] & NRF24_TRACE_RADIO) ? 1 : 0);
+			print_record(record[3],record[4]);
+			printf("\n");
+			previous = time;
+		}
+	}
+	
+	if (input != stdin) fclose(input);
+	return frames ? 0 : 1;
+}
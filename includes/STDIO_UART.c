@@ -1,11 +1,13 @@
 //	https://www.gnu.org/savannah-checkouts/non-gnu/avr-libc/user-manual/group__avr__stdio.html
 
 #ifndef F_CPU
-#define F_CPU 16000000UL 
+#define F_CPU 16000000UL
 #endif
 
 #include <stdio.h>
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
 #include "STDIO_UART.h"
 
 #ifndef BAUD
@@ -14,27 +16,104 @@
 
 #define MYUBRR (((F_CPU / (BAUD * 16UL))) - 1)
 
-static FILE mystdout = FDEV_SETUP_STREAM(uart_putchar, NULL, _FDEV_SETUP_WRITE); 
+static FILE mystdout = FDEV_SETUP_STREAM(uart_putchar, NULL, _FDEV_SETUP_WRITE);
 static FILE mystdin = FDEV_SETUP_STREAM(NULL, uart_getchar, _FDEV_SETUP_READ);
 
+// TX ring, filled by uart_putchar() (producer) and emptied by UDRE interrupt (consumer)
+static volatile uint8_t tx_buffer[UART_TX_BUFFER];
+static volatile uint8_t tx_head;		// Written only by producers, with interrupts off
+static volatile uint8_t tx_tail;		// Written only by consumer
+static volatile uint16_t tx_dropped;
+
 void uart_init(void)
 {
     UBRR0H = MYUBRR >> 8;
     UBRR0L = MYUBRR;
     UCSR0B = (1<<RXEN0)|(1<<TXEN0);
-    
+    tx_head = tx_tail = 0;
+
     stdout = &mystdout;
-    stdin  = &mystdin; 
+    stdin  = &mystdin;
+}
+
+// Next byte from ring goes out, interrupt is turned off when ring is empty
+ISR(USART_UDRE_vect)
+{
+	if (tx_head == tx_tail)
+	{
+		UCSR0B &= ~(1 << UDRIE0);
+		return;
+	}
+	UDR0 = tx_buffer[tx_tail & (UART_TX_BUFFER - 1)];
+	tx_tail++;
+}
+
+static int uart_put(char c)
+{
+	// With interrupts disabled (called from ISR) UDRE interrupt never comes
+	bool blocked = !(SREG & (1 << SREG_I));
+
+	for (;;)
+	{
+		// Room check, slot and head move together, so an ISR printing in between does not
+		// take the same slot. UDRIE0 is cleared by ISR, so it is set here as well
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			if ((uint8_t)(tx_head - tx_tail) != UART_TX_BUFFER)
+			{
+				tx_buffer[tx_head & (UART_TX_BUFFER - 1)] = c;
+				tx_head++;
+				UCSR0B |= (1 << UDRIE0);
+				return 0;
+			}
+			if (UART_TX_DROP)
+			{
+				tx_dropped++;
+				return -1;
+			}
+			// Make room by hand
+			if (blocked && (UCSR0A & (1 << UDRE0)))
+			{
+				UDR0 = tx_buffer[tx_tail & (UART_TX_BUFFER - 1)];
+				tx_tail++;
+			}
+		}
+	}
 }
 
-// Redirect stdout to UART
+// Redirect stdout to UART, characters are queued and sent from UDRE interrupt
 int uart_putchar(char c, FILE *stream) {
 	if (c == '\n') {
-		uart_putchar('\r', stream);
+		uart_put('\r');
+	}
+	return uart_put(c);
+}
+
+// Raw byte without newline translation, for binary data (e.g. nrf24_trace_dump())
+void uart_write(uint8_t byte)
+{
+	uart_put(byte);
+}
+
+// Wait until everything queued is sent (e.g. before sleep or reset)
+void uart_flush(void)
+{
+	while (tx_head != tx_tail)
+	{
+		if (!(SREG & (1 << SREG_I)) && (UCSR0A & (1 << UDRE0)))
+		{
+			UDR0 = tx_buffer[tx_tail & (UART_TX_BUFFER - 1)];
+			tx_tail++;
+		}
 	}
 	loop_until_bit_is_set(UCSR0A, UDRE0);
-	UDR0 = c;
-	return 0;
+}
+
+uint16_t uart_dropped(void)
+{
+	uint16_t value;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) value = tx_dropped;
+	return value;
 }
 
 // Redirect stdin to UART
@@ -3,8 +3,24 @@
 #ifndef STDIO_UART_H_
 #define STDIO_UART_H_
 
+#include <stdint.h>
+#include <stdbool.h>
+
+//	Characters waiting for UART (power of 2, max 128), ~1ms each at 9600 baud
+#ifndef UART_TX_BUFFER
+#define UART_TX_BUFFER	64
+#endif
+
+//	Full buffer: true drops characters (counted by uart_dropped()), false waits for room
+#ifndef UART_TX_DROP
+#define UART_TX_DROP	false
+#endif
+
 void uart_init(void);
-int uart_putchar(char c, FILE *stream); 
+int uart_putchar(char c, FILE *stream);
 int uart_getchar(FILE *stream);
+void uart_write(uint8_t byte);
+void uart_flush(void);
+uint16_t uart_dropped(void);
 
 #endif /* STDIO_UART_H_ */
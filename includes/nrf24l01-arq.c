@@ -0,0 +1,199 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "nrf24l01-hal.h"
+#include "nrf24l01.h"
+#include "nrf24l01-arq.h"
+#include "timer.h"
+
+void nrf24_arq_init(nrf24_arq *arq, nrf24_t *radio, nrf24_arq_handler deliver)
+{
+	memset(arq,0,sizeof(nrf24_arq));
+	arq->radio = radio;
+	arq->deliver = deliver;
+}
+
+static uint8_t nrf24_arq_acked(uint16_t *acked, uint16_t *first, uint16_t sent, uint8_t seq, const uint8_t *ack)
+{
+	uint8_t count = ack[1] - seq;
+	uint16_t map = ack[2] | (ack[3] << 8);
+	uint16_t before = *acked;
+	
+	// ACK from before frames that were not sent yet, nothing to take from it
+	if (count > sent - *first) return 0;
+	
+	// Everything before 'expected' of receiver is in, window moves on
+	*first += count;
+	*acked >>= count;
+	
+	// Bit n of map is frame after 'expected' + n
+	for (uint8_t n = 0; n < ARQ_WINDOW - 1; n++)
+	{
+		if ((map & (1U << n)) && *first + 1 + n < sent) *acked |= (1U << (n + 1));
+	}
+	return count || *acked != before;
+}
+
+uint8_t nrf24_arq_send(nrf24_arq *arq, const uint8_t *buffer, uint16_t length)
+{
+	nrf24_t *radio = arq->radio;
+	uint16_t total = (length + ARQ_DATA - 1) / ARQ_DATA;
+	uint16_t first = 0, sent = 0, last, end, offset;
+	uint16_t acked = 0;				// Bit n is frame 'first' + n
+	uint8_t base = arq->seq, frame[32], size, tries = 0, progress;
+	uint8_t result = NRF24_OK;
+	bool listening = radio->listening;
+	nrf24_frame *reply;
+	uint32_t started;
+	
+	if (length == 0) return NRF24_ERR_LENGTH;
+	
+	while (first < total)
+	{
+		// Burst of every frame in window that is not acknowledged, last one asks for ACK
+		end = first + ARQ_WINDOW < total ? first + ARQ_WINDOW : total;
+		last = end - 1;
+		while (acked & (1U << (last - first))) last--;
+		
+		nrf24_stream_begin(radio);
+		for (uint16_t i = first; i <= last; i++)
+		{
+			if (acked & (1U << (i - first))) continue;
+			offset = i * ARQ_DATA;
+			size = length - offset > ARQ_DATA ? ARQ_DATA : length - offset;
+			frame[0] = ARQ_TYPE | (i == 0 ? ARQ_START : 0) | (i == last ? ARQ_POLL : 0);
+			frame[1] = base + i;
+			frame[2] = size;
+			memcpy(&frame[ARQ_HEADER],buffer + offset,size);
+			nrf24_stream_push_noack(radio,frame,size + ARQ_HEADER);
+			arq->frames++;
+			if (i < sent) arq->retransmits++;
+		}
+		if (last >= sent) sent = last + 1;
+		nrf24_stream_end(radio);
+		
+		// Wait for ACK in RX, anything else that comes in meanwhile is dropped
+		if (!listening) nrf24_start_listening(radio);
+		progress = 0;
+		started = timer_micros();
+		while (timer_micros() - started < ARQ_TIMEOUT)
+		{
+			nrf24_available(radio);
+			reply = nrf24_peek(radio);
+			if (!reply)
+			{
+				hal_idle();
+				continue;
+			}
+			if (reply->length >= 4 && reply->data[0] == ARQ_ACK)
+			{
+				progress = nrf24_arq_acked(&acked,&first,sent,base + first,reply->data);
+				nrf24_release(radio);
+				break;
+			}
+			nrf24_release(radio);
+		}
+		if (!listening) nrf24_stop_listening(radio);
+		
+		// Give up after ARQ_RETRIES polls in a row that moved nothing
+		if (progress) tries = 0;
+		else if (++tries > ARQ_RETRIES)
+		{
+			result = NRF24_ERR_MAX_RT;
+			break;
+		}
+	}
+	
+	// Next transfer starts with a different sequence number, receiver tells them apart by it
+	arq->seq = base + total;
+	if (arq->seq == base) arq->seq++;
+	return result;
+}
+
+uint8_t nrf24_arq_poll(nrf24_arq *arq)
+{
+	uint8_t ack[4];
+	
+	if (!arq->ack_due) return 0;
+	
+	// Next frame expected and which ones after it are already in
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		arq->ack_due = false;
+		ack[1] = arq->expected;
+		ack[2] = arq->received >> 1;
+		ack[3] = arq->received >> 9;
+	}
+	ack[0] = ARQ_ACK;
+	hal_delay_us(ARQ_TURNAROUND);
+	nrf24_send_noack(arq->radio,ack,sizeof(ack));
+	return 1;
+}
+
+uint8_t nrf24_arq_receive(nrf24_arq *arq, const nrf24_frame *frame)
+{
+	uint8_t type, seq, distance, slot, size;
+	
+	if (frame->length <= ARQ_HEADER || (frame->data[0] & ARQ_TYPE_MASK) != ARQ_TYPE) return 0;
+	type = frame->data[0];
+	seq = frame->data[1];
+	size = frame->data[2];
+	if (size == 0 || size > frame->length - ARQ_HEADER) return 0;
+	
+	// New transfer, copies of its first frame have the same sequence number
+	if ((type & ARQ_START) && (!arq->synced || seq != arq->start))
+	{
+		arq->synced = true;
+		arq->start = seq;
+		arq->expected = seq;
+		arq->received = 0;
+	}
+	
+	// Frames in window are kept, older ones are copies of frames already delivered
+	distance = seq - arq->expected;
+	if (arq->synced && distance < ARQ_WINDOW)
+	{
+		slot = seq & (ARQ_WINDOW - 1);
+		if (!(arq->received & (1U << distance)))
+		{
+			memcpy(arq->buffer[slot],&frame->data[ARQ_HEADER],size);
+			arq->length[slot] = size;
+			arq->received |= (1U << distance);
+		}
+		
+		// Hand over everything that is in order
+		while (arq->received & 1)
+		{
+			slot = arq->expected & (ARQ_WINDOW - 1);
+			if (arq->deliver) arq->deliver(arq->buffer[slot],arq->length[slot]);
+			arq->received >>= 1;
+			arq->expected++;
+		}
+	}
+	
+	// ACK goes out from nrf24_arq_poll(), this may run from nrf24_irq()
+	if (type & ARQ_POLL) arq->ack_due = true;
+	return 1;
+}
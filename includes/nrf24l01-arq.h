@@ -0,0 +1,90 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef _NRF24L01_ARQ_H
+#define _NRF24L01_ARQ_H
+
+#include "nrf24l01.h"
+
+//	Bulk transfer without hardware ACK: data frames go out with W_TX_PAYLOAD_NOACK back to back,
+//	up to ARQ_WINDOW of them unacknowledged. Frame header is type (ARQ_DATA with ARQ_START on
+//	first frame of transfer and ARQ_POLL on last frame of a burst), sequence number and data size
+//	(static payloads arrive padded to 32 bytes), followed by up to 29 bytes. Receiver answers poll with {ARQ_ACK, next expected sequence, 16 bit map of
+//	frames after it that are already in}, sender then sends only frames that are missing.
+//	Needs 2mbps, lower data rates lose too many messages without AUTO_ACK.
+#define ARQ_HEADER			3
+#define ARQ_DATA			(32 - ARQ_HEADER)
+#define ARQ_TYPE			0xA0
+#define ARQ_TYPE_MASK		0xFC
+#define ARQ_POLL			0x01
+#define ARQ_START			0x02
+#define ARQ_ACK				0xAC
+
+//	Frames sent before waiting for ACK (power of 2, max 16), receiver keeps as many out of order
+//	(30 bytes RAM each)
+#ifndef ARQ_WINDOW
+#define ARQ_WINDOW			8
+#endif
+
+//	Sender waits this long (us) for ACK and gives up after ARQ_RETRIES polls without progress.
+//	Receiver has to call nrf24_arq_poll() within ARQ_TIMEOUT - ARQ_TURNAROUND of poll
+#ifndef ARQ_TIMEOUT
+#define ARQ_TIMEOUT			1000
+#endif
+#ifndef ARQ_RETRIES
+#define ARQ_RETRIES			10
+#endif
+
+//	Receiver waits this long (us) before answering poll, sender needs 130us to get from TX into RX
+#ifndef ARQ_TURNAROUND
+#define ARQ_TURNAROUND		200
+#endif
+
+//	Receiver hands data over in order, 'length' is 1 - 29 bytes
+typedef void (*nrf24_arq_handler)(const uint8_t *data, uint8_t length);
+
+typedef struct
+{
+	nrf24_t *radio;
+	nrf24_arq_handler deliver;
+	
+	// Sender
+	uint8_t seq;					// Sequence number of next frame
+	uint32_t frames;				// Data frames sent
+	uint32_t retransmits;			// Of those sent again
+	
+	// Receiver, frames after 'expected' wait in slot (sequence & (ARQ_WINDOW - 1))
+	bool synced;					// ARQ_START frame was seen
+	uint8_t start;					// Sequence number of first frame of current transfer
+	uint8_t expected;				// Next sequence number to deliver
+	uint16_t received;				// Bit n is 'expected' + n
+	uint8_t buffer[ARQ_WINDOW][ARQ_DATA];
+	uint8_t length[ARQ_WINDOW];
+	volatile bool ack_due;			// Poll came in, nrf24_arq_poll() answers it
+} nrf24_arq;
+
+void nrf24_arq_init(nrf24_arq *arq, nrf24_t *radio, nrf24_arq_handler deliver);
+uint8_t nrf24_arq_send(nrf24_arq *arq, const uint8_t *buffer, uint16_t length);
+uint8_t nrf24_arq_receive(nrf24_arq *arq, const nrf24_frame *frame);
+uint8_t nrf24_arq_poll(nrf24_arq *arq);
+
+#endif /*_NRF24L01_ARQ_H*/
@@ -0,0 +1,91 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "nrf24l01.h"
+#include "nrf24l01-batch.h"
+#include "timer.h"
+
+void nrf24_batch_init(nrf24_batch *batch, nrf24_t *radio)
+{
+	memset(batch,0,sizeof(nrf24_batch));
+	batch->radio = radio;
+}
+
+uint8_t nrf24_batch_flush(nrf24_batch *batch)
+{
+	uint8_t result;
+	
+	if (!batch->length) return NRF24_OK;
+	
+	// One message for all records, buffer is empty again even if it was not acknowledged
+	result = nrf24_send(batch->radio,batch->buffer,batch->length);
+	batch->messages++;
+	if (result != NRF24_OK) batch->failed++;
+	batch->length = 0;
+	batch->count = 0;
+	return result;
+}
+
+uint8_t nrf24_batch_add(nrf24_batch *batch, const uint8_t *data, uint8_t length)
+{
+	uint8_t result = NRF24_OK;
+	
+	if (length == 0 || length > BATCH_RECORD) return NRF24_ERR_LENGTH;
+	
+	// Record does not fit, send what is packed first
+	if (batch->length + 1 + length > 32) result = nrf24_batch_flush(batch);
+	
+	if (!batch->length) batch->first = timer_millis();
+	batch->buffer[batch->length++] = length;
+	memcpy(&batch->buffer[batch->length],data,length);
+	batch->length += length;
+	batch->count++;
+	batch->records++;
+	
+	// Full message, nothing else fits in it (shortest record is 2 bytes)
+	if (batch->length >= 32 - 1) result = nrf24_batch_flush(batch);
+	return result;
+}
+
+uint8_t nrf24_batch_poll(nrf24_batch *batch)
+{
+	if (!batch->length || timer_millis() - batch->first < BATCH_DEADLINE) return NRF24_OK;
+	batch->deadline++;
+	return nrf24_batch_flush(batch);
+}
+
+uint8_t nrf24_batch_unpack(const nrf24_frame *frame, nrf24_batch_handler handler)
+{
+	uint8_t offset = 0, count = 0;
+	
+	// Record running past end of message means it was not packed by nrf24_batch_add(), rest is dropped
+	while (offset < frame->length && frame->data[offset] && offset + 1 + frame->data[offset] <= frame->length)
+	{
+		handler(&frame->data[offset + 1],frame->data[offset]);
+		offset += 1 + frame->data[offset];
+		count++;
+	}
+	return count;
+}
@@ -0,0 +1,61 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef _NRF24L01_BATCH_H
+#define _NRF24L01_BATCH_H
+
+#include "nrf24l01.h"
+
+//	Small records are packed into one message as length byte (1 - 31) followed by data.
+//	Length 0 or end of message ends the list, so zero padding of static payload is fine
+#define BATCH_RECORD		(32 - 1)
+
+//	Message goes out when next record does not fit, when nrf24_batch_flush() is called or
+//	when oldest record in it is this old (ms, checked by nrf24_batch_poll())
+#ifndef BATCH_DEADLINE
+#define BATCH_DEADLINE		10
+#endif
+
+//	Receiver gets records one by one
+typedef void (*nrf24_batch_handler)(const uint8_t *data, uint8_t length);
+
+typedef struct
+{
+	nrf24_t *radio;
+	uint8_t buffer[32];
+	uint8_t length;					// Bytes packed, 0 when empty
+	uint8_t count;					// Records packed
+	uint32_t first;					// timer_millis() first record was packed
+	
+	uint32_t records;				// Records given to nrf24_batch_add()
+	uint32_t messages;				// Messages sent
+	uint16_t failed;				// Messages not acknowledged, records in them are lost
+	uint16_t deadline;				// Messages sent because of BATCH_DEADLINE
+} nrf24_batch;
+
+void nrf24_batch_init(nrf24_batch *batch, nrf24_t *radio);
+uint8_t nrf24_batch_add(nrf24_batch *batch, const uint8_t *data, uint8_t length);
+uint8_t nrf24_batch_flush(nrf24_batch *batch);
+uint8_t nrf24_batch_poll(nrf24_batch *batch);
+uint8_t nrf24_batch_unpack(const nrf24_frame *frame, nrf24_batch_handler handler);
+
+#endif /*_NRF24L01_BATCH_H*/
@@ -0,0 +1,111 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "nrf24l01.h"
+#include "nrf24l01-mnemonics.h"
+#include "nrf24l01-csma.h"
+#include "timer.h"
+
+void nrf24_csma_init(nrf24_csma *csma, nrf24_t *radio, uint16_t seed)
+{
+	memset(csma,0,sizeof(nrf24_csma));
+	csma->radio = radio;
+	csma->random = seed ? seed : 1;
+}
+
+static void nrf24_csma_backoff(nrf24_csma *csma)
+{
+	// 16 bit xorshift, nodes need different seeds or they back off in step
+	csma->random ^= csma->random << 7;
+	csma->random ^= csma->random >> 9;
+	csma->random ^= csma->random << 8;
+	csma->wait = (uint32_t)(csma->random & ((1 << csma->exponent) - 1)) * CSMA_PERIOD;
+	csma->wait_start = timer_micros();
+	csma->stats.backoff += csma->wait;
+}
+
+uint8_t nrf24_csma_send(nrf24_csma *csma, const uint8_t *buffer, uint8_t length)
+{
+	if (length == 0 || length > 32) return NRF24_ERR_LENGTH;
+	if (csma->length) return NRF24_ERR_FULL;
+	
+	// Asynchronous send pads static payloads itself
+	memcpy(csma->buffer,buffer,length);
+	csma->length = length;
+	csma->exponent = CSMA_MIN_BE;
+	csma->attempts = 0;
+	nrf24_csma_backoff(csma);
+	return NRF24_OK;
+}
+
+uint8_t nrf24_csma_poll(nrf24_csma *csma)
+{
+	nrf24_t *radio = csma->radio;
+	
+	if (!csma->length) return 0;
+	
+	// Message is out when IRQ has seen TX_DS or MAX_RT
+	if (csma->sending)
+	{
+		if (nrf24_busy(radio)) return 1;
+		csma->sending = false;
+		csma->length = 0;
+		csma->result = nrf24_async_result(radio);
+		if (csma->result != NRF24_OK) csma->stats.max_rt++;
+		return 0;
+	}
+	
+	if (!csma->sampling)
+	{
+		// Backoff over, start sampling unless radio is still sending something else
+		if (timer_micros() - csma->wait_start < csma->wait || !nrf24_carrier_begin(radio)) return 1;
+		csma->sampling = true;
+		csma->wait_start = timer_micros();
+		return 1;
+	}
+	if (timer_micros() - csma->wait_start < NRF24_CARRIER_TIME) return 1;
+	csma->sampling = false;
+	
+	if (nrf24_carrier_end(radio))
+	{
+		csma->stats.busy++;
+		if (++csma->attempts >= CSMA_ATTEMPTS)
+		{
+			csma->stats.dropped++;
+			csma->length = 0;
+			csma->result = NRF24_ERR_BUSY;
+			return 0;
+		}
+		if (csma->exponent < CSMA_MAX_BE) csma->exponent++;
+		nrf24_csma_backoff(csma);
+		return 1;
+	}
+	
+	// Channel is free, load message right away
+	if (!nrf24_send_async(radio,csma->buffer,csma->length,0)) return 1;
+	csma->sending = true;
+	csma->stats.sent++;
+	return 1;
+}
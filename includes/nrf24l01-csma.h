@@ -0,0 +1,79 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef _NRF24L01_CSMA_H
+#define _NRF24L01_CSMA_H
+
+#include "nrf24l01.h"
+
+//	Listen before talk: channel is sampled (RPD, carrier over -64dBm) before every send. Message
+//	waits random 0 - 2^BE - 1 backoff periods first, BE goes from CSMA_MIN_BE up by one with every
+//	busy sample until CSMA_MAX_BE. After CSMA_ATTEMPTS busy samples message is dropped.
+//	Nothing blocks: sample is started with nrf24_carrier_begin() and read by a later poll
+//	NRF24_CARRIER_TIME (170us) on, sending is asynchronous (nrf24_send_async). Radio must not be
+//	used for anything else from nrf24_csma_send() until poll returns 0.
+#ifndef CSMA_MIN_BE
+#define CSMA_MIN_BE			2
+#endif
+#ifndef CSMA_MAX_BE
+#define CSMA_MAX_BE			5
+#endif
+#ifndef CSMA_ATTEMPTS
+#define CSMA_ATTEMPTS		5
+#endif
+
+//	Backoff period in us, about as long as it takes from sampling until own carrier is on air
+//	(170us sample, 130us TX settling)
+#ifndef CSMA_PERIOD
+#define CSMA_PERIOD			320
+#endif
+
+typedef struct
+{
+	uint32_t sent;					// Messages that found channel free
+	uint32_t busy;					// Samples that found channel busy
+	uint32_t backoff;				// us waited before sampling
+	uint16_t dropped;				// Channel was busy CSMA_ATTEMPTS times
+	uint16_t max_rt;				// Sent but not acknowledged
+} nrf24_csma_stats;
+
+typedef struct
+{
+	nrf24_t *radio;
+	uint8_t buffer[32];
+	uint8_t length;					// Message waiting or being sent, 0 when done
+	uint8_t result;					// NRF24_OK, NRF24_ERR_MAX_RT or NRF24_ERR_BUSY for last message
+	uint8_t exponent;				// BE
+	uint8_t attempts;				// Busy samples for this message
+	bool sampling;					// RX entered for carrier sample, RPD read after wait
+	bool sending;
+	uint32_t wait_start;			// timer_micros() backoff or sample started
+	uint32_t wait;					// Backoff in us
+	uint16_t random;
+	nrf24_csma_stats stats;
+} nrf24_csma;
+
+void nrf24_csma_init(nrf24_csma *csma, nrf24_t *radio, uint16_t seed);
+uint8_t nrf24_csma_send(nrf24_csma *csma, const uint8_t *buffer, uint8_t length);
+uint8_t nrf24_csma_poll(nrf24_csma *csma);
+
+#endif /*_NRF24L01_CSMA_H*/
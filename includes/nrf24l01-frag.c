@@ -0,0 +1,113 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "nrf24l01.h"
+#include "nrf24l01-frag.h"
+#include "timer.h"
+
+uint8_t nrf24_frag_send(nrf24_t *radio, const uint8_t *buffer, uint16_t length)
+{
+	uint8_t frame[32];
+	uint8_t index = 0, size;
+	
+	if (length > FRAG_MAX_FRAGMENTS * FRAG_DATA) return NRF24_ERR_LENGTH;
+	radio->frag_id++;
+	
+	// All fragments go back to back through TX FIFO, radio switches to TX only once
+	nrf24_stream_begin(radio);
+	do
+	{
+		size = length > FRAG_DATA ? FRAG_DATA : length;
+		length -= size;
+		frame[0] = radio->frag_id;
+		frame[1] = index++ | (length ? 0 : FRAG_LAST);
+		frame[2] = size;
+		memcpy(&frame[FRAG_HEADER],buffer,size);
+		buffer += size;
+		nrf24_stream_push(radio,frame,size + FRAG_HEADER);
+	} while (length);
+	
+	if (!nrf24_stream_end(radio)) return NRF24_ERR_MAX_RT;
+	return NRF24_OK;
+}
+
+void nrf24_frag_init(nrf24_frag *frag)
+{
+	frag->active = false;
+	frag->done = false;
+}
+
+uint8_t nrf24_frag_receive(nrf24_frag *frag, const nrf24_frame *frame)
+{
+	uint8_t id, index, size;
+	uint16_t offset;
+	uint32_t now = timer_millis();
+	
+	if (frame->length < FRAG_HEADER) return 0;
+	id = frame->data[0];
+	index = frame->data[1] & ~FRAG_LAST;
+	size = frame->data[2];
+	if (size > frame->length - FRAG_HEADER) return 0;
+	
+	// Unfinished message took too long, delivered one is old enough to have its id reused
+	if (now - frag->started > FRAG_TIMEOUT) frag->active = frag->done = false;
+	
+	// Late copy of fragment from message that was already delivered
+	if (frag->done && id == frag->id) return 0;
+	
+	if (!frag->active || id != frag->id)
+	{
+		// New message, unfinished one is given up
+		frag->active = true;
+		frag->done = false;
+		frag->id = id;
+		frag->count = 0;
+		frag->last = 0xFF;
+		frag->started = now;
+		memset(frag->received,0,sizeof(frag->received));
+	}
+	
+	// Only last fragment can be shorter, message has to fit into the buffer
+	offset = (uint16_t)index * FRAG_DATA;
+	if (!(frame->data[1] & FRAG_LAST) && size != FRAG_DATA) return 0;
+	if (offset + size > FRAG_MAX_MESSAGE) return 0;
+	
+	// Fragments may come in any order, copies are dropped
+	if (frag->received[index >> 3] & (1 << (index & 7))) return 0;
+	frag->received[index >> 3] |= (1 << (index & 7));
+	frag->count++;
+	memcpy(&frag->buffer[offset],&frame->data[FRAG_HEADER],size);
+	
+	if (frame->data[1] & FRAG_LAST)
+	{
+		frag->last = index;
+		frag->length = offset + size;
+	}
+	
+	if (frag->count != frag->last + 1) return 0;
+	frag->active = false;
+	frag->done = true;
+	return 1;
+}
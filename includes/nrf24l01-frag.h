@@ -0,0 +1,66 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef _NRF24L01_FRAG_H
+#define _NRF24L01_FRAG_H
+
+#include "nrf24l01.h"
+
+//	Messages longer than 32 bytes are split into fragments with 3 byte header: message id,
+//	fragment index (bit 7 set on last fragment) and data size, followed by up to 29 bytes.
+//	Size is carried because without dynamic payload every fragment arrives as 32 bytes
+#define FRAG_HEADER			3
+#define FRAG_DATA			(32 - FRAG_HEADER)
+#define FRAG_LAST			0x80
+#define FRAG_MAX_FRAGMENTS	128
+
+//	Longest message receiver can put together
+#ifndef FRAG_MAX_MESSAGE
+#define FRAG_MAX_MESSAGE	256
+#endif
+
+//	Unfinished message is dropped when it is not complete this long (ms) after first fragment,
+//	fragments of delivered message are dropped as duplicates for the same time
+#ifndef FRAG_TIMEOUT
+#define FRAG_TIMEOUT		100
+#endif
+
+//	Reassembly state of one receiver, 'buffer' and 'length' hold the message
+//	after nrf24_frag_receive() returned 1 until next fragment is given to it
+typedef struct
+{
+	uint8_t buffer[FRAG_MAX_MESSAGE];
+	uint16_t length;
+	uint8_t received[(FRAG_MAX_MESSAGE + FRAG_DATA - 1) / FRAG_DATA / 8 + 1];	// Bitmap of fragments
+	uint8_t count;					// Fragments received
+	uint8_t last;					// Index of last fragment, 0xFF until it arrives
+	uint8_t id;
+	bool active;					// Message is being put together
+	bool done;						// Message 'id' was delivered
+	uint32_t started;
+} nrf24_frag;
+
+uint8_t nrf24_frag_send(nrf24_t *radio, const uint8_t *buffer, uint16_t length);
+void nrf24_frag_init(nrf24_frag *frag);
+uint8_t nrf24_frag_receive(nrf24_frag *frag, const nrf24_frame *frame);
+
+#endif /*_NRF24L01_FRAG_H*/
@@ -0,0 +1,69 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef _NRF24L01_HAL_H
+#define _NRF24L01_HAL_H
+
+//	Everything nrf24l01.c needs from the MCU besides SPI (spi.h): CE/CSN pins, IRQ pin,
+//	delays, idle wait, critical sections and constants in flash.
+//	AVR build uses registers directly, NRF24_HOST build (see host/) runs the driver
+//	against simulated radios and takes all of it from host/sim.h.
+
+#ifdef NRF24_HOST
+#include "sim.h"
+#else
+
+// Set clock frequency
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/delay.h>
+#include <util/atomic.h>
+
+//	CE/CSN pin, DDRx is right below PORTx
+static inline void hal_pin_output(volatile uint8_t *port, uint8_t mask) { *(port - 1) |= mask; }
+static inline void hal_pin_high(volatile uint8_t *port, uint8_t mask) { *port |= mask; }
+static inline void hal_pin_low(volatile uint8_t *port, uint8_t mask) { *port &= ~mask; }
+
+//	Interrupt on falling edge of INT0 (PD2) or INT1 (PD3) from IRQ pin
+static inline void hal_irq_init(uint8_t irq)
+{
+	cli();
+	EICRA |= (1 << (ISC01 + 2 * irq));
+	EIMSK |= (1 << (INT0 + irq));
+	sei();
+}
+
+//	_delay_us/_delay_ms need constant argument, so these stay macros
+#define hal_delay_us(us)	_delay_us(us)
+#define hal_delay_ms(ms)	_delay_ms(ms)
+
+//	Waiting for flag set from ISR, nothing to do on MCU
+#define hal_idle()			do {} while (0)
+
+#endif /*NRF24_HOST*/
+
+#endif /*_NRF24L01_HAL_H*/
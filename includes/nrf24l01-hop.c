@@ -0,0 +1,125 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "nrf24l01.h"
+#include "nrf24l01-hop.h"
+#include "timer.h"
+
+static void nrf24_hop_send_beacon(nrf24_hop *hop)
+{
+	uint8_t beacon[HOP_BEACON_LENGTH] = { HOP_BEACON, hop->multiplier, hop->offset, hop->index };
+	
+	// Every listening node would ACK at the same moment
+	nrf24_send_noack(hop->radio,beacon,sizeof(beacon));
+}
+
+void nrf24_hop_init(nrf24_hop *hop, nrf24_t *radio, uint16_t seed, const uint8_t *busy, bool master)
+{
+	uint8_t multiplier = seed % NRF24_CHANNELS;
+	
+	// Multiplier without common factors with 126 (2, 3, 7) visits every channel once per 126 hops
+	while (!(multiplier & 1) || !(multiplier % 3) || !(multiplier % 7)) multiplier++;
+	
+	hop->radio = radio;
+	memcpy(hop->busy,busy,NRF24_SCAN_BYTES);
+	hop->multiplier = multiplier;
+	hop->offset = (seed >> 8) % NRF24_CHANNELS;
+	hop->index = 0;
+	hop->master = master;
+	hop->synced = false;
+	hop->missed = 0;
+	hop->next = hop->heard = timer_millis();
+	
+	// Gateway starts hopping, node waits for beacon on first channel
+	nrf24_set_channel(radio,nrf24_hop_channel(hop,0));
+	if (master)
+	{
+		hop->next += HOP_DWELL;
+		nrf24_hop_send_beacon(hop);
+	}
+}
+
+uint8_t nrf24_hop_channel(const nrf24_hop *hop, uint8_t index)
+{
+	uint8_t channel;
+	
+	// Busy channel is replaced by next free one in sequence
+	for (uint8_t i = 0; i < NRF24_CHANNELS; i++)
+	{
+		channel = ((uint16_t)hop->multiplier * index + hop->offset) % NRF24_CHANNELS;
+		if (!NRF24_CHANNEL_BUSY(hop->busy,channel)) return channel;
+		if (++index == NRF24_CHANNELS) index = 0;
+	}
+	
+	// Everything busy, stay on sequence
+	return ((uint16_t)hop->multiplier * index + hop->offset) % NRF24_CHANNELS;
+}
+
+void nrf24_hop_poll(nrf24_hop *hop)
+{
+	uint32_t now = timer_millis();
+	
+	if ((int32_t)(now - hop->next) < 0) return;
+	
+	// Own clock keeps counting hops, also while gateway is not heard
+	if (++hop->index == NRF24_CHANNELS) hop->index = 0;
+	hop->next += HOP_DWELL;
+	
+	// Node without gateway waits on the channel gateway should come to next, a wait that
+	// runs longer than HOP_LOST hops moves on to the next expected one
+	if (!hop->master && (!hop->synced || now - hop->heard > (uint32_t)HOP_LOST * HOP_DWELL))
+	{
+		if (hop->synced || ++hop->missed >= HOP_LOST)
+		{
+			hop->synced = false;
+			hop->missed = 0;
+			nrf24_set_channel(hop->radio,nrf24_hop_channel(hop,hop->index + 1 == NRF24_CHANNELS ? 0 : hop->index + 1));
+		}
+		return;
+	}
+	
+	nrf24_set_channel(hop->radio,nrf24_hop_channel(hop,hop->index));
+	if (hop->master) nrf24_hop_send_beacon(hop);
+}
+
+uint8_t nrf24_hop_receive(nrf24_hop *hop, const nrf24_frame *frame)
+{
+	// Without dynamic payload beacon arrives padded to 32 bytes, sequence has to be ours
+	if (frame->length < HOP_BEACON_LENGTH || frame->data[0] != HOP_BEACON) return 0;
+	if (frame->data[1] != hop->multiplier || frame->data[2] != hop->offset || frame->data[3] >= NRF24_CHANNELS) return 0;
+	if (hop->master) return 1;
+	
+	// Beacon is sent right after hop, dwell on this channel started now
+	hop->heard = timer_millis();
+	hop->next = hop->heard + HOP_DWELL - HOP_EARLY;
+	hop->synced = true;
+	hop->missed = 0;
+	if (hop->index != frame->data[3])
+	{
+		hop->index = frame->data[3];
+		nrf24_set_channel(hop->radio,nrf24_hop_channel(hop,hop->index));
+	}
+	return 1;
+}
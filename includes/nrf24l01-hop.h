@@ -0,0 +1,70 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef _NRF24L01_HOP_H
+#define _NRF24L01_HOP_H
+
+#include "nrf24l01.h"
+
+//	Gateway (master) moves to next channel every HOP_DWELL ms and sends 4 byte beacon
+//	{HOP_BEACON, multiplier, offset, hop index} without ACK, nodes follow on their own clock
+//	and correct it from beacons. HOP_BEACON is reserved as first byte of application frames
+#ifndef HOP_DWELL
+#define HOP_DWELL			50
+#endif
+#define HOP_BEACON			0xB5
+#define HOP_BEACON_LENGTH	4
+
+//	Node hops this many ms before gateway, so it is on the channel when beacon goes out
+//	(beacon is timed when main loop takes it from the queue, which is later)
+#ifndef HOP_EARLY
+#define HOP_EARLY			2
+#endif
+
+//	Node that misses beacons for this many hops waits on the channel gateway should visit next,
+//	and moves on to a later one after as many hops without beacon
+#ifndef HOP_LOST
+#define HOP_LOST			4
+#endif
+
+//	Hop sequence is a * index + b (mod 126) with 'a' and 'b' from shared seed,
+//	busy channels from nrf24_scan() are skipped (gateway and nodes need the same map)
+typedef struct
+{
+	nrf24_t *radio;
+	uint8_t busy[NRF24_SCAN_BYTES];
+	uint8_t multiplier;
+	uint8_t offset;
+	uint8_t index;					// Position in sequence (0 - 125)
+	uint32_t next;					// timer_millis() of next hop
+	uint32_t heard;					// timer_millis() of last beacon
+	uint8_t missed;					// Hops spent waiting on one channel while lost
+	bool master;
+	bool synced;					// Node follows gateway
+} nrf24_hop;
+
+void nrf24_hop_init(nrf24_hop *hop, nrf24_t *radio, uint16_t seed, const uint8_t *busy, bool master);
+uint8_t nrf24_hop_channel(const nrf24_hop *hop, uint8_t index);
+void nrf24_hop_poll(nrf24_hop *hop);
+uint8_t nrf24_hop_receive(nrf24_hop *hop, const nrf24_frame *frame);
+
+#endif /*_NRF24L01_HOP_H*/
@@ -0,0 +1,226 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "nrf24l01.h"
+#include "nrf24l01-mnemonics.h"
+#include "nrf24l01-mesh.h"
+#include "timer.h"
+
+// Node address without id
+static const uint8_t mesh_base[4] = { MESH_ADDRESS };
+
+static void nrf24_mesh_address(uint8_t *address, uint8_t id)
+{
+	address[0] = id;
+	memcpy(&address[1],mesh_base,sizeof(mesh_base));
+}
+
+void nrf24_mesh_init(nrf24_mesh *mesh, nrf24_t *radio, uint8_t id, bool relay)
+{
+	uint8_t address[5];
+	
+	memset(mesh,0,sizeof(nrf24_mesh));
+	memset(mesh->seen,0xFF,sizeof(mesh->seen));
+	mesh->radio = radio;
+	mesh->id = id;
+	mesh->relay = relay;
+	
+	// Own address on pipe 1, pipe 0 is only open for ACKs while sending (see nrf24_mesh_forward)
+	nrf24_mesh_address(address,id);
+	nrf24_open_pipe(radio,1,address);
+	nrf24_close_pipe(radio,0);
+}
+
+nrf24_route * nrf24_mesh_lookup(nrf24_mesh *mesh, uint8_t destination)
+{
+	nrf24_route *fallback = 0;
+	
+	for (uint8_t i = 0; i < mesh->route_count; i++)
+	{
+		if (mesh->routes[i].destination == destination) return &mesh->routes[i];
+		if (mesh->routes[i].destination == MESH_ANY) fallback = &mesh->routes[i];
+	}
+	return fallback;
+}
+
+static nrf24_route * nrf24_mesh_entry(nrf24_mesh *mesh, uint8_t destination, uint8_t hops)
+{
+	nrf24_route *route = 0;
+	
+	for (uint8_t i = 0; i < mesh->route_count; i++)
+	{
+		if (mesh->routes[i].destination == destination) return &mesh->routes[i];
+	}
+	if (mesh->route_count < MESH_ROUTES) route = &mesh->routes[mesh->route_count++];
+	else
+	{
+		// Table is full, learned route that takes most hops makes room if it is longer
+		for (uint8_t i = 0; i < MESH_ROUTES; i++)
+		{
+			if (mesh->routes[i].fixed || mesh->routes[i].hops <= hops) continue;
+			if (!route || mesh->routes[i].hops > route->hops) route = &mesh->routes[i];
+		}
+		if (!route) return 0;
+	}
+	memset(route,0,sizeof(nrf24_route));
+	route->destination = destination;
+	route->hops = 0xFF;
+	return route;
+}
+
+uint8_t nrf24_mesh_route(nrf24_mesh *mesh, uint8_t destination, uint8_t next, uint8_t hops)
+{
+	nrf24_route *route = nrf24_mesh_entry(mesh,destination,0);
+	
+	if (!route) return NRF24_ERR_FULL;
+	if (route->next != next) route->sent = route->failed = route->latency = 0;
+	route->next = next;
+	route->hops = hops;
+	route->fixed = true;
+	return NRF24_OK;
+}
+
+static void nrf24_mesh_learn(nrf24_mesh *mesh, uint8_t destination, uint8_t next, uint8_t hops)
+{
+	nrf24_route *route;
+	
+	if (destination == mesh->id || destination == MESH_ANY) return;
+	route = nrf24_mesh_entry(mesh,destination,hops);
+	
+	// Shorter path wins, path over the same neighbour is refreshed
+	if (!route || route->fixed || (hops > route->hops && next != route->next)) return;
+	if (route->next != next) route->sent = route->failed = route->latency = 0;
+	route->next = next;
+	route->hops = hops;
+}
+
+static uint8_t nrf24_mesh_seen(nrf24_mesh *mesh, uint8_t source, uint8_t seq)
+{
+	uint16_t key = (source << 8) | seq;
+	
+	for (uint8_t i = 0; i < MESH_SEEN; i++)
+	{
+		if (mesh->seen[i] == key) return 1;
+	}
+	mesh->seen[mesh->seen_next] = key;
+	mesh->seen_next = (mesh->seen_next + 1) % MESH_SEEN;
+	return 0;
+}
+
+static uint8_t nrf24_mesh_forward(nrf24_mesh *mesh, uint8_t *frame, uint8_t length, uint8_t destination)
+{
+	nrf24_t *radio = mesh->radio;
+	nrf24_route *route = nrf24_mesh_lookup(mesh,destination);
+	uint8_t address[5], value, result;
+	uint32_t latency;
+	
+	if (!route)
+	{
+		mesh->stats.no_route++;
+		return NRF24_ERR_NO_ROUTE;
+	}
+	
+	// Next hop gets it, ACK comes back on pipe 0 which is open only for this send,
+	// otherwise this node would acknowledge messages meant for its neighbours
+	frame[5] = mesh->id;
+	nrf24_mesh_address(address,route->next);
+	nrf24_set_tx_address(radio,address);
+	value = radio->shadow.reg[EN_RXADDR] | (1 << ERX_P0);
+	nrf24_write(radio,EN_RXADDR,&value,1);
+	latency = timer_micros();
+	result = nrf24_send(radio,frame,length);
+	latency = timer_micros() - latency;
+	nrf24_close_pipe(radio,0);
+	
+	// Per hop latency, avg = 7/8 avg + 1/8 latency
+	if (latency > 0xFFFF) latency = 0xFFFF;
+	route->latency = route->sent ? route->latency - (route->latency >> 3) + (latency >> 3) : latency;
+	if (route->sent != 0xFFFF) route->sent++;
+	if (result != NRF24_OK)
+	{
+		if (route->failed != 0xFFFF) route->failed++;
+		mesh->stats.failed++;
+	}
+	return result;
+}
+
+uint8_t nrf24_mesh_send(nrf24_mesh *mesh, uint8_t destination, const uint8_t *buffer, uint8_t length)
+{
+	uint8_t frame[32];
+	
+	if (length == 0 || length > MESH_DATA) return NRF24_ERR_LENGTH;
+	frame[0] = MESH_TYPE;
+	frame[1] = mesh->id;
+	frame[2] = destination;
+	frame[3] = mesh->seq++;
+	frame[4] = MESH_TTL;
+	frame[6] = length;
+	memcpy(&frame[MESH_HEADER],buffer,length);
+	return nrf24_mesh_forward(mesh,frame,length + MESH_HEADER,destination);
+}
+
+uint8_t nrf24_mesh_receive(nrf24_mesh *mesh, nrf24_frame *frame)
+{
+	uint8_t *header = frame->data;
+	uint8_t source, destination, hops, ttl;
+	
+	if (frame->length < MESH_HEADER || header[0] != MESH_TYPE) return 0;
+	if (header[6] == 0 || header[6] > frame->length - MESH_HEADER) return 0;
+	source = header[1];
+	destination = header[2];
+	hops = header[4] >> 4;
+	ttl = header[4] & 0x0F;
+	
+	// Own message that came back over another relay
+	if (source == mesh->id) return 0;
+	
+	// Way back to source is over the node that sent it here
+	nrf24_mesh_learn(mesh,source,header[5],hops + 1);
+	if (nrf24_mesh_seen(mesh,source,header[3]))
+	{
+		mesh->stats.duplicates++;
+		return 0;
+	}
+	
+	if (destination == mesh->id)
+	{
+		mesh->source = source;
+		mesh->data = &header[MESH_HEADER];
+		mesh->length = header[6];
+		mesh->stats.delivered++;
+		return 1;
+	}
+	
+	// Store and forward straight from the frame (e.g. still in RX queue from nrf24_peek())
+	if (!mesh->relay) return 0;
+	if (ttl <= 1)
+	{
+		mesh->stats.expired++;
+		return 0;
+	}
+	header[4] = ((hops < 15 ? hops + 1 : 15) << 4) | (ttl - 1);
+	if (nrf24_mesh_forward(mesh,header,header[6] + MESH_HEADER,destination) == NRF24_OK) mesh->stats.relayed++;
+	return 0;
+}
@@ -0,0 +1,104 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef _NRF24L01_MESH_H
+#define _NRF24L01_MESH_H
+
+#include "nrf24l01.h"
+
+//	Network layer over point-to-point links. Every node has 1 byte id (MESH_GATEWAY is 0) and
+//	listens on pipe 1 to MESH_ADDRESS with id as LSB. Message has 7 byte header: MESH_TYPE,
+//	source, destination, sequence number of source, hops | TTL, id of node that sent it last
+//	and data length (static payloads arrive padded to 32 bytes), followed by up to 25 bytes. Nodes that relay forward messages for others to next hop from
+//	routing table, route back to source is learned from every message that comes in.
+#define MESH_HEADER			7
+#define MESH_DATA			(32 - MESH_HEADER)
+#define MESH_TYPE			0x4D
+#define MESH_GATEWAY		0
+#define MESH_ANY			0xFF			// Default route, for destinations not in table
+
+//	Upper 4 bytes of node address, LSB is node id
+#ifndef MESH_ADDRESS
+#define MESH_ADDRESS		0xc2, 0xc2, 0xc2, 0xc2
+#endif
+
+//	Hops a message can take (max 15), routing table entries and messages remembered
+//	to drop copies that come back over another path or after lost ACK
+#ifndef MESH_TTL
+#define MESH_TTL			4
+#endif
+#ifndef MESH_ROUTES
+#define MESH_ROUTES			8
+#endif
+#ifndef MESH_SEEN
+#define MESH_SEEN			8
+#endif
+
+//	Route to 'destination' over neighbour 'next'. Send latency to 'next' (load to TX_DS/MAX_RT)
+//	is averaged over messages as avg = 7/8 avg + 1/8 latency
+typedef struct
+{
+	uint8_t destination;
+	uint8_t next;
+	uint8_t hops;
+	bool fixed;						// Set with nrf24_mesh_route(), not replaced by learned ones
+	uint16_t latency;				// us
+	uint16_t sent;
+	uint16_t failed;				// MAX_RT to 'next'
+} nrf24_route;
+
+typedef struct
+{
+	uint32_t delivered;				// Messages for this node
+	uint32_t relayed;
+	uint16_t duplicates;
+	uint16_t expired;				// TTL ran out
+	uint16_t no_route;
+	uint16_t failed;				// Next hop did not acknowledge
+} nrf24_mesh_stats;
+
+//	After nrf24_mesh_receive() returned 1, 'source', 'data' (points into the frame) and 'length'
+//	describe the message until next call
+typedef struct
+{
+	nrf24_t *radio;
+	uint8_t id;
+	bool relay;						// Forward messages for others (mains-powered nodes)
+	uint8_t seq;
+	nrf24_route routes[MESH_ROUTES];
+	uint8_t route_count;
+	uint16_t seen[MESH_SEEN];		// Source << 8 | sequence number
+	uint8_t seen_next;
+	nrf24_mesh_stats stats;
+	
+	uint8_t source;
+	const uint8_t *data;
+	uint8_t length;
+} nrf24_mesh;
+
+void nrf24_mesh_init(nrf24_mesh *mesh, nrf24_t *radio, uint8_t id, bool relay);
+uint8_t nrf24_mesh_route(nrf24_mesh *mesh, uint8_t destination, uint8_t next, uint8_t hops);
+nrf24_route * nrf24_mesh_lookup(nrf24_mesh *mesh, uint8_t destination);
+uint8_t nrf24_mesh_send(nrf24_mesh *mesh, uint8_t destination, const uint8_t *buffer, uint8_t length);
+uint8_t nrf24_mesh_receive(nrf24_mesh *mesh, nrf24_frame *frame);
+
+#endif /*_NRF24L01_MESH_H*/
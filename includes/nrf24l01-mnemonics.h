@@ -15,7 +15,6 @@
 
 #ifndef __NORDIC_NRF24L01_RADIO_H__
 #define __NORDIC_NRF24L01_RADIO_H__
-#include <avr/common.h>
 
 /* SPI commands */
 #define REGISTER_MASK		0b00011111
@@ -0,0 +1,309 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "nrf24l01.h"
+#include "nrf24l01-mnemonics.h"
+#include "nrf24l01-tdma.h"
+#include "timer.h"
+
+// Gateway and beacon address without LSB
+static const uint8_t tdma_base[4] = { TDMA_ADDRESS };
+
+static void nrf24_tdma_address(uint8_t *address, uint8_t lsb)
+{
+	address[0] = lsb;
+	memcpy(&address[1],tdma_base,sizeof(tdma_base));
+}
+
+static uint16_t nrf24_tdma_beacon_delay(nrf24_t *radio)
+{
+	uint8_t rf_setup = radio->shadow.reg[RF_SETUP];
+	uint8_t config = radio->shadow.reg[CONFIG];
+	uint8_t crc = (config & (1 << EN_CRC)) ? ((config & (1 << CRC0)) ? 2 : 1) : 0;
+	uint8_t length = (radio->shadow.feature & (1 << EN_DPL)) ? 3 + TDMA_SLOTS : 32;
+	uint16_t bits;
+	
+	// 15us CE pulse and 130us TX settling, then preamble (2 bytes on 2mbps), address,
+	// 9 bit packet control field, beacon (padded to 32 bytes without DPL) and CRC
+	bits = 8 * (1 + radio->shadow.reg[SETUP_AW] + 2 + length + crc) + 9;
+	if (rf_setup & (1 << RF_DR_LOW)) return 145 + bits * 4;
+	if (rf_setup & (1 << RF_DR_HIGH)) return 145 + (bits + 8) / 2;
+	return 145 + bits;
+}
+
+void nrf24_tdma_init(nrf24_tdma *tdma, nrf24_t *radio, uint8_t id, bool low_power)
+{
+	uint8_t address[5];
+	
+	memset(tdma,0,sizeof(nrf24_tdma));
+	tdma->radio = radio;
+	tdma->id = id;
+	tdma->low_power = low_power && id != TDMA_GATEWAY;
+	tdma->slot = 0xFF;
+	tdma->random = id | 1;
+	
+	// Gateway listens for nodes and sends beacons to all of them, nodes the other way round.
+	// Pipe 0 is open only while a node sends, for ACK (see nrf24_tdma_transmit)
+	nrf24_tdma_address(address,id == TDMA_GATEWAY ? TDMA_GATEWAY : TDMA_BROADCAST);
+	nrf24_open_pipe(radio,1,address);
+	nrf24_tdma_address(address,id == TDMA_GATEWAY ? TDMA_BROADCAST : TDMA_GATEWAY);
+	nrf24_set_tx_address(radio,address);
+	nrf24_close_pipe(radio,0);
+	nrf24_start_listening(radio);
+	tdma->beacon_delay = nrf24_tdma_beacon_delay(radio);
+	
+	// Gateway sends first beacon on first poll, node waits for it
+	if (id == TDMA_GATEWAY)
+	{
+		tdma->synced = true;
+		tdma->start = timer_micros() - TDMA_FRAME;
+	}
+}
+
+uint8_t nrf24_tdma_assign(nrf24_tdma *tdma, uint8_t slot, uint8_t node)
+{
+	if (slot >= TDMA_SLOTS) return 0;
+	tdma->owner[slot] = node;
+	tdma->active[slot] = tdma->frame;
+	return 1;
+}
+
+uint8_t nrf24_tdma_send(nrf24_tdma *tdma, const uint8_t *buffer, uint8_t length)
+{
+	if (length == 0 || length > 32) return NRF24_ERR_LENGTH;
+	if (tdma->pending_length) return NRF24_ERR_FULL;
+	memcpy(tdma->pending,buffer,length);
+	tdma->pending_length = length;
+	tdma->queued = timer_micros();
+	tdma->left = false;
+	return NRF24_OK;
+}
+
+void nrf24_tdma_leave(nrf24_tdma *tdma)
+{
+	// Waiting message is dropped, TDMA_LEAVE goes out in own slot instead
+	tdma->pending_length = 0;
+	tdma->left = true;
+}
+
+static uint8_t nrf24_tdma_transmit(nrf24_tdma *tdma, const uint8_t *buffer, uint8_t length)
+{
+	nrf24_t *radio = tdma->radio;
+	uint8_t value, result;
+	
+	// ACK from gateway comes on pipe 0, closed otherwise so nodes do not acknowledge each other
+	value = radio->shadow.reg[EN_RXADDR] | (1 << ERX_P0);
+	nrf24_write(radio,EN_RXADDR,&value,1);
+	result = nrf24_send(radio,buffer,length);
+	nrf24_close_pipe(radio,0);
+	return result;
+}
+
+static void nrf24_tdma_beacon(nrf24_tdma *tdma)
+{
+	uint8_t beacon[3 + TDMA_SLOTS] = { TDMA_BEACON, tdma->frame, TDMA_SLOTS };
+	
+	// Every node hears it, nobody acknowledges
+	memcpy(&beacon[3],tdma->owner,TDMA_SLOTS);
+	nrf24_send_noack(tdma->radio,beacon,sizeof(beacon));
+}
+
+static uint8_t nrf24_tdma_random(nrf24_tdma *tdma)
+{
+	// 8 bit xorshift, differs per node id
+	tdma->random ^= tdma->random << 3;
+	tdma->random ^= tdma->random >> 5;
+	tdma->random ^= tdma->random << 4;
+	return tdma->random;
+}
+
+static void nrf24_tdma_wake(nrf24_tdma *tdma)
+{
+	if (!tdma->asleep) return;
+	tdma->asleep = false;
+	nrf24_state(tdma->radio,POWERUP);
+	nrf24_start_listening(tdma->radio);
+}
+
+void nrf24_tdma_poll(nrf24_tdma *tdma)
+{
+	uint32_t now = timer_micros();
+	uint32_t elapsed, slot_start;
+	uint8_t join[2] = { TDMA_JOIN, tdma->id };
+	uint8_t leave[2] = { TDMA_LEAVE, tdma->id };
+	
+	if (tdma->id == TDMA_GATEWAY)
+	{
+		// Beacon opens every superframe, clock is not moved when poll comes late
+		if (now - tdma->start < TDMA_FRAME) return;
+		tdma->start = now - tdma->start < 2 * TDMA_FRAME ? tdma->start + TDMA_FRAME : now;
+		tdma->frame++;
+		
+		// Node that went away without TDMA_LEAVE loses its slot
+		for (uint8_t i = 0; i < TDMA_SLOTS; i++)
+		{
+			if (tdma->owner[i] && (uint8_t)(tdma->frame - tdma->active[i]) > TDMA_IDLE) tdma->owner[i] = 0;
+		}
+		nrf24_tdma_beacon(tdma);
+		return;
+	}
+	
+	if (!tdma->synced) return;
+	
+	// Beacons stopped, listen until gateway is back
+	if (now - tdma->heard > (uint32_t)TDMA_LOST * TDMA_FRAME)
+	{
+		tdma->synced = false;
+		tdma->slot = 0xFF;
+		nrf24_tdma_wake(tdma);
+		return;
+	}
+	
+	// Missed beacon, superframe goes on by own clock
+	while (now - tdma->start >= TDMA_FRAME)
+	{
+		tdma->start += TDMA_FRAME;
+		tdma->frame++;
+	}
+	elapsed = now - tdma->start;
+	
+	// Radio has to be up and listening before next beacon
+	if (elapsed >= TDMA_FRAME - TDMA_WAKEUP) nrf24_tdma_wake(tdma);
+	
+	if (tdma->slot != 0xFF)
+	{
+		// Own slot, message goes out if first half of slot is still left.
+		// Failed one waits for next superframe, slot without messages is kept with TDMA_JOIN
+		slot_start = (1 + tdma->slot) * TDMA_SLOT;
+		if (elapsed >= slot_start + TDMA_GUARD && elapsed < slot_start + TDMA_SLOT / 2 && tdma->done != tdma->frame)
+		{
+			tdma->done = tdma->frame;
+			if (tdma->left)
+			{
+				if (nrf24_tdma_transmit(tdma,leave,sizeof(leave)) == NRF24_OK) tdma->slot = 0xFF;
+			}
+			else if (tdma->pending_length)
+			{
+				if (nrf24_tdma_transmit(tdma,tdma->pending,tdma->pending_length) == NRF24_OK)
+				{
+					tdma->latency = timer_micros() - tdma->queued;
+					if (tdma->latency > tdma->latency_max) tdma->latency_max = tdma->latency;
+					tdma->pending_length = 0;
+					tdma->used = tdma->frame;
+				}
+			}
+			else if ((uint8_t)(tdma->frame - tdma->used) >= TDMA_IDLE / 2)
+			{
+				if (nrf24_tdma_transmit(tdma,join,sizeof(join)) == NRF24_OK) tdma->used = tdma->frame;
+			}
+		}
+		
+		// Nothing more to do until next beacon
+		if (tdma->low_power && !tdma->asleep && elapsed >= slot_start + TDMA_SLOT && elapsed < TDMA_FRAME - TDMA_WAKEUP)
+		{
+			tdma->asleep = true;
+			nrf24_state(tdma->radio,POWERDOWN);
+		}
+		return;
+	}
+	
+	// Without slot ask for one in contention slot, every other superframe on average
+	// so nodes joining at the same time do not collide every time
+	if (tdma->left) return;
+	slot_start = (1 + TDMA_SLOTS) * TDMA_SLOT;
+	if (elapsed >= slot_start + TDMA_GUARD && elapsed < slot_start + TDMA_SLOT / 2 && tdma->done != tdma->frame)
+	{
+		tdma->done = tdma->frame;
+		if (nrf24_tdma_random(tdma) & 0x10) nrf24_tdma_transmit(tdma,join,sizeof(join));
+	}
+}
+
+uint8_t nrf24_tdma_receive(nrf24_tdma *tdma, const nrf24_frame *frame)
+{
+	uint32_t elapsed;
+	uint8_t slots, slot;
+	
+	// Gateway: anything heard in a slot keeps it taken
+	if (tdma->id == TDMA_GATEWAY)
+	{
+		elapsed = (timer_micros() - tdma->start) / TDMA_SLOT;
+		if (elapsed >= 1 && elapsed <= TDMA_SLOTS) tdma->active[elapsed - 1] = tdma->frame;
+	}
+	
+	if (frame->length < 2) return 0;
+	
+	if (frame->data[0] == TDMA_JOIN)
+	{
+		if (tdma->id != TDMA_GATEWAY) return 1;
+		
+		// Node gets first free slot, it sees it in next beacon
+		for (uint8_t i = 0; i < TDMA_SLOTS; i++)
+		{
+			if (tdma->owner[i] == frame->data[1]) return 1;
+		}
+		for (uint8_t i = 0; i < TDMA_SLOTS; i++)
+		{
+			if (tdma->owner[i]) continue;
+			tdma->owner[i] = frame->data[1];
+			tdma->active[i] = tdma->frame;
+			break;
+		}
+		return 1;
+	}
+	
+	if (frame->data[0] == TDMA_LEAVE)
+	{
+		if (tdma->id != TDMA_GATEWAY) return 1;
+		for (uint8_t i = 0; i < TDMA_SLOTS; i++)
+		{
+			if (tdma->owner[i] == frame->data[1]) tdma->owner[i] = 0;
+		}
+		return 1;
+	}
+	
+	if (frame->data[0] != TDMA_BEACON || frame->length < 3) return 0;
+	if (tdma->id == TDMA_GATEWAY) return 1;
+	
+	// Superframe started when gateway sent beacon
+	tdma->heard = timer_micros();
+	tdma->start = tdma->heard - tdma->beacon_delay;
+	tdma->frame = frame->data[1];
+	tdma->synced = true;
+	
+	slots = frame->data[2] < TDMA_SLOTS ? frame->data[2] : TDMA_SLOTS;
+	if (slots > frame->length - 3) slots = frame->length - 3;
+	memset(tdma->owner,0,sizeof(tdma->owner));
+	memcpy(tdma->owner,&frame->data[3],slots);
+	slot = tdma->slot;
+	tdma->slot = 0xFF;
+	for (uint8_t i = 0; i < slots; i++)
+	{
+		if (tdma->owner[i] == tdma->id) tdma->slot = i;
+	}
+	
+	// New slot counts as used, keep-alive starts TDMA_IDLE / 2 superframes later
+	if (slot == 0xFF && tdma->slot != 0xFF) tdma->used = tdma->frame;
+	return 1;
+}
@@ -0,0 +1,110 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef _NRF24L01_TDMA_H
+#define _NRF24L01_TDMA_H
+
+#include "nrf24l01.h"
+
+//	Gateway sends beacon every superframe: TDMA_SLOT us beacon slot, TDMA_SLOTS data slots
+//	and one contention slot for joining. Beacon is {TDMA_BEACON, superframe number, number of
+//	slots, node id owning each slot (0 = free)}. Nodes set their clock from beacon, send only in
+//	their own slot and ask for one with {TDMA_JOIN, node id} in contention slot. Node gives its slot
+//	back with {TDMA_LEAVE, node id} in it, gateway frees slots it has heard nothing in for TDMA_IDLE
+//	superframes, so node with nothing to send repeats TDMA_JOIN in its slot every TDMA_IDLE / 2.
+//	Gateway listens on TDMA_ADDRESS with LSB 0, nodes on TDMA_ADDRESS with LSB 0xFF for beacons.
+#define TDMA_BEACON			0xB7
+#define TDMA_JOIN			0xB8
+#define TDMA_LEAVE			0xB9
+#define TDMA_GATEWAY		0x00
+#define TDMA_BROADCAST		0xFF
+
+#ifndef TDMA_ADDRESS
+#define TDMA_ADDRESS		0xc3, 0xc3, 0xc3, 0xc3
+#endif
+
+//	Data slots (max 29) and slot length in us, slot has to fit one message with retransmits
+#ifndef TDMA_SLOTS
+#define TDMA_SLOTS			8
+#endif
+#ifndef TDMA_SLOT
+#define TDMA_SLOT			2000UL
+#endif
+#define TDMA_FRAME			((TDMA_SLOTS + 2) * TDMA_SLOT)
+
+//	Node waits this long (us) into its slot for clocks that drifted apart and for its main loop
+//	picking beacon up late. Beacon's own delay (TX settling and air time) comes from datarate
+//	and payload size, see nrf24_tdma_init
+#ifndef TDMA_GUARD
+#define TDMA_GUARD			200
+#endif
+
+//	Node with low_power wakes radio up this long (us) before next beacon (1.5ms start up + RX settling)
+#ifndef TDMA_WAKEUP
+#define TDMA_WAKEUP			2500
+#endif
+
+//	Node without beacon for this many superframes stops sending and listens until next one
+#ifndef TDMA_LOST
+#define TDMA_LOST			4
+#endif
+
+//	Gateway frees slot nothing was heard in for this many superframes (max 127)
+#ifndef TDMA_IDLE
+#define TDMA_IDLE			32
+#endif
+
+typedef struct
+{
+	nrf24_t *radio;
+	uint8_t id;						// TDMA_GATEWAY or node id 1 - 254
+	bool low_power;					// Node powers radio down between its slot and next beacon
+	uint8_t owner[TDMA_SLOTS];		// Node id per slot, gateway's table or copy from last beacon
+	uint8_t active[TDMA_SLOTS];		// Gateway: superframe slot was last heard in
+	uint8_t frame;					// Superframe number
+	uint32_t start;					// timer_micros() when current superframe started
+	uint32_t heard;					// timer_micros() of last beacon
+	uint16_t beacon_delay;			// us from gateway's superframe start to beacon received
+	bool synced;
+	uint8_t slot;					// Own slot, 0xFF without one
+	uint8_t done;					// Superframe number own slot or join was used in
+	uint8_t used;					// Superframe number own slot last carried something
+	bool left;						// Slot given back, no new one until next nrf24_tdma_send()
+	uint8_t random;
+	bool asleep;
+	
+	// Message waiting for own slot
+	uint8_t pending[32];
+	uint8_t pending_length;
+	uint32_t queued;				// timer_micros() message was given to nrf24_tdma_send()
+	uint32_t latency;				// us from nrf24_tdma_send() until it was sent, last message
+	uint32_t latency_max;
+} nrf24_tdma;
+
+void nrf24_tdma_init(nrf24_tdma *tdma, nrf24_t *radio, uint8_t id, bool low_power);
+uint8_t nrf24_tdma_assign(nrf24_tdma *tdma, uint8_t slot, uint8_t node);
+uint8_t nrf24_tdma_send(nrf24_tdma *tdma, const uint8_t *buffer, uint8_t length);
+void nrf24_tdma_leave(nrf24_tdma *tdma);
+void nrf24_tdma_poll(nrf24_tdma *tdma);
+uint8_t nrf24_tdma_receive(nrf24_tdma *tdma, const nrf24_frame *frame);
+
+#endif /*_NRF24L01_TDMA_H*/
@@ -0,0 +1,129 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf24l01-hal.h"
+#include "nrf24l01-trace.h"
+#include "timer.h"
+
+#if NRF24_TRACE
+// Ring of records, 'head' is next one to write
+static struct
+{
+	uint16_t millis;
+	uint8_t ticks;
+	uint8_t event;
+	uint8_t value;
+} trace[NRF24_TRACE_SIZE];
+static uint8_t trace_head;
+static uint8_t trace_count;
+static bool trace_paused;			// Dump in progress, records would mix with the frame
+#endif
+
+void nrf24_trace_record(uint8_t event, uint8_t value)
+{
+#if NRF24_TRACE
+	uint8_t slot;
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if (!trace_paused)
+		{
+			slot = trace_head++ & (NRF24_TRACE_SIZE - 1);
+			timer_raw(&trace[slot].millis,&trace[slot].ticks);
+			trace[slot].event = event;
+			trace[slot].value = value;
+			if (trace_count < NRF24_TRACE_SIZE) trace_count++;
+		}
+	}
+#endif
+}
+
+void nrf24_trace_clear(void)
+{
+#if NRF24_TRACE
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) trace_count = 0;
+#endif
+}
+
+#if NRF24_TRACE
+static void nrf24_trace_put(void (*put)(uint8_t byte), const uint8_t *bytes, uint8_t length, uint8_t *sum)
+{
+	while (length--)
+	{
+		*sum += *bytes;
+		put(*bytes++);
+	}
+}
+
+static void nrf24_trace_put16(void (*put)(uint8_t byte), uint16_t value, uint8_t *sum)
+{
+	uint8_t bytes[2] = { value, value >> 8 };
+	nrf24_trace_put(put,bytes,2,sum);
+}
+
+static void nrf24_trace_put32(void (*put)(uint8_t byte), uint32_t value, uint8_t *sum)
+{
+	uint8_t bytes[4] = { value, value >> 8, value >> 16, value >> 24 };
+	nrf24_trace_put(put,bytes,4,sum);
+}
+#endif
+
+uint8_t nrf24_trace_dump(void (*put)(uint8_t byte))
+{
+	uint8_t count = 0;
+#if NRF24_TRACE
+	uint8_t sum = 0, slot;
+	
+	// Ring stays still while it is sent (events in the meantime are not recorded)
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		trace_paused = true;
+		count = trace_count;
+	}
+	
+	put(NRF24_TRACE_SYNC1);
+	put(NRF24_TRACE_SYNC2);
+	nrf24_trace_put(put,&count,1,&sum);
+	nrf24_trace_put32(put,timer_millis(),&sum);
+	nrf24_trace_put16(put,TIMER_TICK_NS,&sum);
+	for (uint8_t i = 0; i < count; i++)
+	{
+		slot = (uint8_t)(trace_head - count + i) & (NRF24_TRACE_SIZE - 1);
+		nrf24_trace_put16(put,trace[slot].millis,&sum);
+		nrf24_trace_put(put,&trace[slot].ticks,1,&sum);
+		nrf24_trace_put(put,&trace[slot].event,1,&sum);
+		nrf24_trace_put(put,&trace[slot].value,1,&sum);
+	}
+	put(sum);
+	
+	// Sent records are gone, next dump continues from here
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		trace_count = 0;
+		trace_paused = false;
+	}
+#endif
+	return count;
+}
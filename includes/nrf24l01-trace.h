@@ -0,0 +1,68 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef _NRF24L01_TRACE_H
+#define _NRF24L01_TRACE_H
+
+#include <stdint.h>
+
+//	Driver events go into a RAM ring as timestamped binary records instead of printf, so
+//	tracing does not change the timing being looked at. Oldest records are overwritten.
+//	Off by default, -DNRF24_TRACE=1 turns it on (5 bytes RAM per record)
+#ifndef NRF24_TRACE
+#define NRF24_TRACE			0
+#endif
+#ifndef NRF24_TRACE_SIZE
+#define NRF24_TRACE_SIZE	32		// Records (power of 2, max 128)
+#endif
+
+//	Events, bit 7 is set for radio on INT1
+#define NRF24_TRACE_STATE	1		// nrf24_state(), value is POWERUP - STANDBY2
+#define NRF24_TRACE_MODE	2		// Radio went to NRF24_TIME_* (RX, TX, STANDBY, POWERDOWN)
+#define NRF24_TRACE_CE		3		// CE pin, value 0 or 1
+#define NRF24_TRACE_IRQ		4		// nrf24_irq() entry, value is STATUS
+#define NRF24_TRACE_STATUS	5		// STATUS when send finished (TX_DS or MAX_RT)
+#define NRF24_TRACE_FLUSH	6		// value is FLUSH_TX or FLUSH_RX
+#define NRF24_TRACE_RADIO	0x80
+
+//	Records keep raw timer_raw() time (low 16 bits of ms and Timer0 ticks), so recording
+//	costs no multiply. Dump frame: sync 0xA5 0x5A, record count, timer_millis() at dump
+//	(4 bytes), TIMER_TICK_NS (2 bytes), records oldest first (ms 2 bytes, ticks, event, value),
+//	8 bit sum of all bytes after sync. Numbers are little endian. host/trace.c turns frames
+//	into a timeline in us, records have to be less than 65s old at dump
+#define NRF24_TRACE_SYNC1	0xA5
+#define NRF24_TRACE_SYNC2	0x5A
+#define NRF24_TRACE_HEADER	7
+#define NRF24_TRACE_RECORD	5
+
+#if NRF24_TRACE
+#define nrf24_trace(radio, event, value) \
+	nrf24_trace_record((event) | ((radio)->irq ? NRF24_TRACE_RADIO : 0), (value))
+#else
+#define nrf24_trace(radio, event, value)	do {} while (0)
+#endif
+
+void nrf24_trace_record(uint8_t event, uint8_t value);
+uint8_t nrf24_trace_dump(void (*put)(uint8_t byte));
+void nrf24_trace_clear(void);
+
+#endif /*_NRF24L01_TRACE_H*/
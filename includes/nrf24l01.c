@@ -20,354 +20,1165 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
-// Set clock frequency
-#ifndef F_CPU
-#define F_CPU 16000000UL
-#endif
-
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <util/delay.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
 
 // nRF24L01+ include files
+#include "nrf24l01-hal.h"
 #include "nrf24l01.h"
 #include "nrf24l01-mnemonics.h"
+#include "nrf24l01-trace.h"
 #include "spi.h"
+#include "timer.h"
 
-// Settings
-uint8_t rx_address[5] = { 0xe7, 0xe7, 0xe7, 0xe7, 0xe7 };	// Read pipe address
-uint8_t tx_address[5] = { 0xe7, 0xe7, 0xe7, 0xe7, 0xe7 };	// Write pipe address
-#define READ_PIPE		0									// Number of read pipe
+// Settings (same for every radio)
+#define RX_ADDRESS		0xe7, 0xe7, 0xe7, 0xe7, 0xe7		// Read pipe address
+#define TX_ADDRESS		0xe7, 0xe7, 0xe7, 0xe7, 0xe7		// Write pipe address
+#define READ_PIPE		0									// Number of read pipe (0 or 1)
 //
 // -AUTO_ACK can be disabled when running on 2MBPS @ <= 32 byte messages.
 // -250KBPS and 1MBPS with AUTO_ACK disabled lost many packets
 // if the packet size was bigger than 4 bytes.
 // -If AUTO_ACK is enabled, tx_address = rx_address.
 //
+// -AUTO_ACK, DATARATE and DYN_PAYLOAD can be given from compiler command line (-D).
+//
+#ifndef AUTO_ACK
 #define AUTO_ACK		false								// Auto acknowledgment
+#endif
+#ifndef DATARATE
 #define DATARATE		RF_DR_2MBPS							// 250kbps, 1mbps, 2mbps
+#endif
 #define POWER			POWER_MAX							// Set power (MAX 0dBm..HIGH -6dBm..LOW -12dBm.. MIN -18dBm)
 #define CHANNEL			0x74								// 2.4GHz-2.5GHz channel selection (0x01 - 0x7C)
+#ifndef DYN_PAYLOAD
 #define DYN_PAYLOAD		true								// Dynamic payload enabled
+#endif
 #define CONTINUOUS		false								// Continuous carrier transmit mode (not tested)
 //
-// ISR(INT0_vect) is triggered depending on config (only one can be true)
+// ISR(INT0_vect) is triggered depending on config, it has to call nrf24_irq()
+// which reads STATUS once and dispatches RX/TX/MAX_RT to registered callbacks
 //
 #define RX_INTERRUPT	true								// Interrupt when message is received (RX)
-#define TX_INTERRUPT	false								// Interrupt when message is sent (TX)
-#define RT_INTERRUPT	false								// Interrupt when maximum re-transmits are reached (MAX_RT)
+#define TX_INTERRUPT	true								// Interrupt when message is sent (TX)
+#define RT_INTERRUPT	true								// Interrupt when maximum re-transmits are reached (MAX_RT)
 //
 // -PIN map.
-// -If CE or CSN is changed to different PIN e.g. PC0
-// then change DDRB -> DDRC, PORTB -> PORTC and so on
+// -CE, CSN and IRQ are given per radio with NRF24_RADIO() (see nrf24l01.h),
+// MOSI, MISO and SCK are shared and set up in spi.c
 //
-// CE
-#define CE_DDR		DDRB
-#define CE_PORT		PORTB
-#define CE_PIN		DDB1									// CE connected to PB1
-// CSN
-#define CSN_DDR		DDRB
-#define CSN_PORT	PORTB
-#define CSN_PIN		DDB2									// CSN connected to PB2
-// IRQ
-#define IRQ_DDR		DDRD
-#define IRQ_PORT	PORTD
-#define IRQ_PIN		DDD2									// IRQ connected to PD2
-// MOSI
-#define MOSI_DDR	DDRB
-#define MOSI_PORT	PORTB
-#define MOSI_PIN	DDB3
-// MISO
-#define MISO_DDR	DDRB
-#define MISO_PORT	PORTB
-#define MISO_PIN	DDB4
-// SCK
-#define SCK_DDR		DDRB
-#define SCK_PORT	PORTB
-#define SCK_PIN		DDB5
-
-// PIN toggling
-#define setbit(port, bit) (port) |= (1 << (bit))
-#define clearbit(port, bit) (port) &= ~(1 << (bit))
-#define ce_low clearbit(CE_PORT,CE_PIN)
-#define ce_high setbit(CE_PORT,CE_PIN)
-#define csn_low clearbit(CSN_PORT,CSN_PIN)
-#define csn_high setbit(CSN_PORT,CSN_PIN)
-
-// Used to store SPI commands
-uint8_t data;
-
-uint8_t nrf24_send_spi(uint8_t register_address, void *data, unsigned int bytes)
+
+// PIN toggling, CE pulses go into trace
+#define ce_low(radio) do { hal_pin_low((radio)->ce_port,(radio)->ce_mask); nrf24_trace(radio,NRF24_TRACE_CE,0); } while (0)
+#define ce_high(radio) do { hal_pin_high((radio)->ce_port,(radio)->ce_mask); nrf24_trace(radio,NRF24_TRACE_CE,1); } while (0)
+
+// Register image written by nrf24_init(), computed from settings at compile time.
+// Every entry is register, length and value.
+static const uint8_t init_image[] PROGMEM =
 {
-	uint8_t status;
-	csn_low;
-	status = spi_exchange(register_address);
-	for (unsigned int i = 0; i < bytes; i++)
-	((uint8_t*)data)[i] = spi_exchange(((uint8_t*)data)[i]);
-	csn_high;
-	return status;
+	// Power up in RX mode with IRQ sources from settings (0 = enabled) and 2 byte CRC
+	CONFIG, 1,
+	(!(RX_INTERRUPT) << MASK_RX_DR) | (!(TX_INTERRUPT) << MASK_TX_DS) | (!(RT_INTERRUPT) << MASK_MAX_RT) |
+	(1 << EN_CRC) | (1 << CRC0) | (1 << PWR_UP) | (1 << PRIM_RX),
+	
+	// Auto-acknowledge on all pipes
+	EN_AA, 1,
+	(AUTO_ACK << ENAA_P5) | (AUTO_ACK << ENAA_P4) | (AUTO_ACK << ENAA_P3) |
+	(AUTO_ACK << ENAA_P2) | (AUTO_ACK << ENAA_P1) | (AUTO_ACK << ENAA_P0),
+	
+	// SETUP_RETR is set by nrf24_auto_retries() once data rate is known
+	
+	RF_CH, 1, CHANNEL,
+	
+	// Continuous carrier transmit, data rate and PA level
+	RF_SETUP, 1,
+	(CONTINUOUS << CONT_WAVE) | ((DATARATE >> RF_DR_HIGH) << RF_DR_HIGH) | ((POWER >> RF_PWR) << RF_PWR),
+	
+	// Dynamic payload on all pipes
+	DYNPD, 1,
+	(DYN_PAYLOAD << DPL_P5) | (DYN_PAYLOAD << DPL_P4) | (DYN_PAYLOAD << DPL_P3) |
+	(DYN_PAYLOAD << DPL_P2) | (DYN_PAYLOAD << DPL_P1) | (DYN_PAYLOAD << DPL_P0),
+	
+	// W_TX_PAYLOAD_NOACK is ignored without EN_DYN_ACK, so it is always on
+	FEATURE, 1,
+	(DYN_PAYLOAD << EN_DPL) | (AUTO_ACK << EN_ACK_PAY) | (1 << EN_DYN_ACK),
+	
+	// Open pipes
+	RX_ADDR_P0 + READ_PIPE, 5, RX_ADDRESS,
+	TX_ADDR, 5, TX_ADDRESS,
+	EN_RXADDR, 1, (1 << READ_PIPE),
+	
+	// Without dynamic payload every message is 32 bytes long
+	RX_PW_P0 + READ_PIPE, 1, DYN_PAYLOAD ? 0 : 32,
+	
+	// Clear RX_DR/TX_DS/MAX_RT by writing 1 into them and flush TX/RX FIFOs
+	STATUS, 1, (1 << RX_DR) | (1 << TX_DS) | (1 << MAX_RT),
+	FLUSH_RX, 0,
+	FLUSH_TX, 0
+};
+
+#if NRF24_LOG
+// Log queue shared by all radios, filled from anywhere (ISR too) and emptied by nrf24_log_flush()
+static struct
+{
+	const char *format;
+	uint16_t a, b;
+} log_queue[NRF24_LOG_SIZE];
+static uint8_t log_head, log_tail;
+static uint8_t log_dropped;
+#endif
+
+void nrf24_log_P(const char *format, uint16_t a, uint16_t b)
+{
+#if NRF24_LOG
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if ((uint8_t)(log_head - log_tail) == NRF24_LOG_SIZE)
+		{
+			if (log_dropped != 0xFF) log_dropped++;
+		}
+		else
+		{
+			log_queue[log_head & (NRF24_LOG_SIZE - 1)].format = format;
+			log_queue[log_head & (NRF24_LOG_SIZE - 1)].a = a;
+			log_queue[log_head & (NRF24_LOG_SIZE - 1)].b = b;
+			log_head++;
+		}
+	}
+#endif
+}
+
+uint8_t nrf24_log_flush(void)
+{
+	uint8_t count = 0;
+#if NRF24_LOG
+	const char *format;
+	uint16_t a, b;
+	uint8_t dropped;
+	
+	// Printing happens with interrupts on, entry is copied out first
+	while (log_head != log_tail)
+	{
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			format = log_queue[log_tail & (NRF24_LOG_SIZE - 1)].format;
+			a = log_queue[log_tail & (NRF24_LOG_SIZE - 1)].a;
+			b = log_queue[log_tail & (NRF24_LOG_SIZE - 1)].b;
+			log_tail++;
+		}
+		printf_P(format,a,b);
+		count++;
+	}
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		dropped = log_dropped;
+		log_dropped = 0;
+	}
+	if (dropped) printf_P(PSTR("%u log entries dropped\n"),dropped);
+#endif
+	return count;
+}
+
+static void nrf24_stats_state(nrf24_t *radio, uint8_t state)
+{
+	uint32_t now, elapsed;
+	
+	if (state != radio->stats_state) nrf24_trace(radio,NRF24_TRACE_MODE,state);
+	
+	// Whole ms go to state radio was in, remainder carries over to the next one
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		now = timer_micros();
+		elapsed = now - radio->stats_since;
+		radio->stats.time[radio->stats_state] += elapsed / 1000;
+		radio->stats_since = now - elapsed % 1000;
+		radio->stats_state = state;
+	}
+}
+
+void nrf24_get_stats(nrf24_t *radio, nrf24_stats *stats)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		nrf24_stats_state(radio,radio->stats_state);
+		memcpy(stats,&radio->stats,sizeof(nrf24_stats));
+	}
+}
+
+void nrf24_clear_stats(nrf24_t *radio)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		memset(&radio->stats,0,sizeof(nrf24_stats));
+		radio->stats_since = timer_micros();
+	}
+}
+
+void nrf24_submit_spi(nrf24_t *radio, struct spi_transfer *transfer)
+{
+	// Queue transfer for this radio and return, SPI interrupt clocks it out
+	transfer->csn_port = radio->csn_port;
+	transfer->csn_mask = radio->csn_mask;
+	spi_submit(transfer);
+}
+
+static uint8_t nrf24_transfer_padded(nrf24_t *radio, uint8_t command, const uint8_t *tx, uint8_t *rx, uint8_t length, uint8_t pad)
+{
+	struct spi_transfer transfer = { .command = command, .tx = tx, .rx = rx, .length = length, .pad = pad };
+	
+	// Few bytes are quicker to poll than to take SPI interrupt for each one, spi_wait()
+	// polls SPIF with interrupts disabled. Transfers already queued are finished first.
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		nrf24_submit_spi(radio,&transfer);
+		spi_wait(&transfer);
+		radio->status = transfer.status;
+		radio->stats.spi_bytes += length + pad + 1;
+	}
+	return transfer.status;
+}
+
+static uint8_t nrf24_transfer(nrf24_t *radio, uint8_t command, const uint8_t *tx, uint8_t *rx, uint8_t length)
+{
+	return nrf24_transfer_padded(radio,command,tx,rx,length,0);
+}
+
+uint8_t nrf24_status(nrf24_t *radio)
+{
+	// NOP is single byte, STATUS comes back without reading any register
+	return nrf24_transfer(radio,NOP,0,0,0);
+}
+
+uint8_t nrf24_last_status(nrf24_t *radio)
+{
+	return radio->status;
+}
+
+uint8_t nrf24_status_pipe(nrf24_t *radio)
+{
+	// 7 when RX FIFO is empty
+	return (radio->status >> RX_P_NO) & 0x07;
+}
+
+uint8_t nrf24_status_tx_full(nrf24_t *radio)
+{
+	return (radio->status >> TX_FULL) & 1;
+}
+
+uint8_t nrf24_status_rx_ready(nrf24_t *radio)
+{
+	return (radio->status >> RX_DR) & 1;
+}
+
+uint8_t nrf24_send_spi(nrf24_t *radio, uint8_t register_address, void *data, unsigned int bytes)
+{
+	return nrf24_transfer(radio,register_address,data,data,bytes);
+}
+
+static void nrf24_send_payload(nrf24_t *radio, uint8_t command, const uint8_t *buffer, uint8_t length)
+{
+	// Bytes go out straight from caller's buffer. Without dynamic payload receiver takes only
+	// 32 byte messages, shorter ones get zeros clocked out after them in the same transaction
+	nrf24_transfer_padded(radio,command,buffer,0,length,DYN_PAYLOAD ? 0 : 32 - length);
+}
+
+uint8_t nrf24_write_payload(nrf24_t *radio, const uint8_t *buffer, uint8_t length)
+{
+	if (length == 0 || length > 32) return NRF24_ERR_LENGTH;
+	if (nrf24_status(radio) & (1 << TX_FULL)) return NRF24_ERR_FULL;
+	nrf24_send_payload(radio,AUTO_ACK ? W_TX_PAYLOAD : W_TX_PAYLOAD_NOACK,buffer,length);
+	return NRF24_OK;
+}
+
+uint8_t nrf24_read_payload(nrf24_t *radio, uint8_t *buffer, uint8_t *length, uint8_t *pipe)
+{
+	uint8_t status, width;
+	uint8_t result = NRF24_OK;
+	
+	// Width and payload have to come from the same message, keep nrf24_irq() out
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		// STATUS tells which pipe message came from, RX_P_NO is 7 when RX FIFO is empty.
+		// R_RX_PL_WID is defined only with dynamic payload, static width is RX_PW_Px (32)
+		if (DYN_PAYLOAD) status = nrf24_read(radio,R_RX_PL_WID,&width,1);
+		else
+		{
+			status = nrf24_status(radio);
+			width = 32;
+		}
+		if (((status >> RX_P_NO) & 0x07) == 0x07) result = NRF24_ERR_EMPTY;
+		else if (width == 0 || width > 32)
+		{
+			// Corrupted length, has to be flushed
+			nrf24_write(radio,FLUSH_RX,0,0);
+			result = NRF24_ERR_CORRUPT;
+		}
+		else
+		{
+			// Bytes come in straight into caller's buffer
+			nrf24_send_spi(radio,R_RX_PAYLOAD,buffer,width);
+			*length = width;
+			if (pipe) *pipe = (status >> RX_P_NO) & 0x07;
+		}
+	}
+	return result;
+}
+
+static uint8_t * nrf24_shadow(nrf24_t *radio, uint8_t register_address, uint8_t *size)
+{
+	nrf24_registers *shadow = &radio->shadow;
+	
+	*size = 1;
+	if (register_address <= RF_SETUP) return &shadow->reg[register_address];
+	if (register_address == DYNPD) return &shadow->dynpd;
+	if (register_address == FEATURE) return &shadow->feature;
+	if (register_address >= RX_ADDR_P2 && register_address <= RX_ADDR_P5) return &shadow->rx_addr_p2[register_address - RX_ADDR_P2];
+	*size = 5;
+	if (register_address == RX_ADDR_P0) return shadow->rx_addr_p0;
+	if (register_address == RX_ADDR_P1) return shadow->rx_addr_p1;
+	if (register_address == TX_ADDR) return shadow->tx_addr;
+	return 0;
 }
 
-uint8_t nrf24_write(uint8_t register_address, uint8_t *data, unsigned int bytes)
+uint8_t nrf24_write(nrf24_t *radio, uint8_t register_address, const uint8_t *data, unsigned int bytes)
 {
-	return nrf24_send_spi(W_REGISTER | register_address, data, bytes);
+	uint8_t size;
+	uint8_t *cached = nrf24_shadow(radio,register_address,&size);
+	
+	// Keep RAM copy in step with the chip, caller's data is only sent
+	if (cached) memcpy(cached,data,bytes < size ? bytes : size);
+	else if (register_address == FLUSH_TX || register_address == FLUSH_RX) nrf24_trace(radio,NRF24_TRACE_FLUSH,register_address);
+	return nrf24_transfer(radio,W_REGISTER | register_address,data,0,bytes);
 }
 
-uint8_t nrf24_read(uint8_t register_address, uint8_t *data, unsigned int bytes)
+uint8_t nrf24_read(nrf24_t *radio, uint8_t register_address, uint8_t *data, unsigned int bytes)
 {
-	return nrf24_send_spi(R_REGISTER | register_address, data, bytes);
+	return nrf24_transfer(radio,R_REGISTER | register_address,0,data,bytes);
 }
 
-void nrf24_init(void)
+uint8_t nrf24_init(nrf24_t *radio)
 {
-	// Interrupt on falling edge of INT0 (PD2) from IRQ pin
-	cli();					// Disable interrupts
-	EICRA |= (1 << ISC01);
-	EIMSK |= (1 << INT0);
-	sei();					// Enable interrupts
+	uint8_t buffer[5], length, config;
+	uint8_t retries = 100;
+	uint8_t *cached;
+	
+	// Library state
+	radio->listening = false;
+	radio->tx_busy = false;
+	radio->tx_result = NRF24_OK;
+	radio->rx_head = radio->rx_tail = 0;
+	radio->rx_pending = false;
+	memset(radio->ack_pending,0,sizeof(radio->ack_pending));
+	radio->stats_state = NRF24_TIME_STANDBY;
+	nrf24_clear_stats(radio);
+	
+	// Interrupt on falling edge of IRQ pin
+	hal_irq_init(radio->irq);
 	
 	// CSN and CE as outputs and initial states
-	setbit(CE_DDR,CE_PIN);
-	setbit(CSN_DDR,CSN_PIN);
-	csn_high;
-	ce_low;
+	hal_pin_output(radio->ce_port,radio->ce_mask);
+	hal_pin_output(radio->csn_port,radio->csn_mask);
+	hal_pin_high(radio->csn_port,radio->csn_mask);
+	ce_low(radio);
 	
 	// Initialize SPI
 	spi_master_init();
-	_delay_ms(100);				// Power on reset 100ms
-	
-	// Start nRF24L01+ config
-	data =
-	(!(RX_INTERRUPT) << MASK_RX_DR) |	// IRQ interrupt on RX (0 = enabled)
-	(!(TX_INTERRUPT) << MASK_TX_DS) |	// IRQ interrupt on TX (0 = enabled)
-	(!(RT_INTERRUPT) << MASK_MAX_RT) |	// IRQ interrupt on auto retransmit counter overflow (0 = enabled)
-	(1 << EN_CRC) |						// CRC enable
-	(1 << CRC0) |						// CRC scheme
-	(1 << PWR_UP) |						// Power up
-	(1 << PRIM_RX);						// TX/RX select
-	nrf24_write(CONFIG,&data,1);
 	
-	// Auto-acknowledge on all pipes
-	data =
-	(AUTO_ACK << ENAA_P5) |
-	(AUTO_ACK << ENAA_P4) |
-	(AUTO_ACK << ENAA_P3) |
-	(AUTO_ACK << ENAA_P2) |
-	(AUTO_ACK << ENAA_P1) |
-	(AUTO_ACK << ENAA_P0);
-	nrf24_write(EN_AA,&data,1);
-	
-	// Set retries
-	data = 0xF0;				// Delay 4000us with 1 re-try (will be added in settings)
-	nrf24_write(SETUP_RETR,&data,1);
-	
-	// Disable RX addresses
-	data = 0;
-	nrf24_write(EN_RXADDR, &data, 1);
-	
-	// Set channel
-	data = CHANNEL;
-	nrf24_write(RF_CH,&data,1);
-	
-	// Setup
-	data =
-	(CONTINUOUS << CONT_WAVE) |					// Continuous carrier transmit
-	((DATARATE >> RF_DR_HIGH) << RF_DR_HIGH) |	// Data rate
-	((POWER >> RF_PWR) << RF_PWR);				// PA level
-	nrf24_write(RF_SETUP,&data,1);
-	
-	// Status - clear TX/RX FIFO's and MAX_RT by writing 1 into them
-	data =
-	(1 << RX_DR) |								// RX FIFO
-	(1 << TX_DS) |								// TX FIFO
-	(1 << MAX_RT);								// MAX RT
-	nrf24_write(STATUS,&data,1);
+	// Instead of waiting 100ms for power on reset, ask chip until SETUP_AW looks sane
+	// (nothing on MISO reads as 0x00 or 0xFF)
+	nrf24_read(radio,SETUP_AW,buffer,1);
+	while (buffer[0] == 0 || buffer[0] > 3)
+	{
+		if (!retries--)
+		{
+			nrf24_log("No chip on CSN 0x%02x\n",radio->csn_mask,0);
+			return NRF24_ERR_NO_CHIP;
+		}
+		hal_delay_ms(1);
+		nrf24_read(radio,SETUP_AW,buffer,1);
+	}
 	
-	// Dynamic payload on all pipes
-	data =
-	(DYN_PAYLOAD << DPL_P0) |
-	(DYN_PAYLOAD << DPL_P1) |
-	(DYN_PAYLOAD << DPL_P2) |
-	(DYN_PAYLOAD << DPL_P3) |
-	(DYN_PAYLOAD << DPL_P4) |
-	(DYN_PAYLOAD << DPL_P5);
-	nrf24_write(DYNPD, &data,1);
-
-	// Enable dynamic payload
-	data =
-	(DYN_PAYLOAD << EN_DPL) |
-	(AUTO_ACK << EN_ACK_PAY) |
-	(AUTO_ACK << EN_DYN_ACK);
-	nrf24_write(FEATURE,&data,1);
-	
-	// Flush TX/RX
-	// Clear RX FIFO which will reset interrupt
-	uint8_t data = (1 << RX_DR) | (1 << TX_DS) | (1 << MAX_RT);
-	nrf24_write(FLUSH_RX,0,0);
-	nrf24_write(FLUSH_TX,0,0);
+	// RAM copy is read from the chip, which keeps its registers over an MCU reset or sleep.
+	// Registers the image does not write (SETUP_AW, RX_ADDR_P1 - P5) stay as they were
+	for (uint8_t register_address = CONFIG; register_address <= FEATURE; register_address++)
+	{
+		cached = nrf24_shadow(radio,register_address,&length);
+		if (cached) nrf24_read(radio,register_address,cached,length);
+	}
 	
-	// Open pipes
-	nrf24_write(RX_ADDR_P0 + READ_PIPE,rx_address,5);
-	nrf24_write(TX_ADDR,tx_address,5);
-	nrf24_write(EN_RXADDR,&data,1);
-	data |= (1 << READ_PIPE);
-	nrf24_write(EN_RXADDR,&data,1);
+	// Chip still powered up from before (e.g. MCU woke up from sleep) needs no start up time
+	config = radio->shadow.reg[CONFIG];
+	
+	// Write register image, one transaction per register
+	for (uint8_t i = 0; i < sizeof(init_image); i += length + 2)
+	{
+		length = pgm_read_byte(&init_image[i + 1]);
+		memcpy_P(buffer,&init_image[i + 2],length);
+		nrf24_write(radio,pgm_read_byte(&init_image[i]),buffer,length);
+	}
+	
+	// Shortest retransmit delay that still fits full ACK payload, adapted while sending
+	radio->retry_adaptive = false;
+	if (AUTO_ACK) nrf24_auto_retries(radio,32);
+	
+	// 1.5ms from POWERDOWN to start up
+	if (!(config & (1 << PWR_UP))) hal_delay_us(1500);
+	
+	return NRF24_OK;
 }
 
-void nrf24_write_ack(void)
+uint8_t nrf24_open_pipe(nrf24_t *radio, uint8_t pipe, const uint8_t *address)
 {
-	const void *ack = "A";
-	unsigned int length = 1;
-	csn_low;
-	spi_send(W_ACK_PAYLOAD);
-	while (length--) spi_send(*(uint8_t *)ack++);
-	csn_high;
+	uint8_t value;
+	
+	if (pipe > 5) return NRF24_ERR_PIPE;
+	
+	// Pipes 0 and 1 have full address, pipes 2 - 5 only LSB and share the rest with pipe 1
+	nrf24_write(radio,RX_ADDR_P0 + pipe,address,pipe < 2 ? 5 : 1);
+	
+	// Without dynamic payload every message is 32 bytes long
+	if (!DYN_PAYLOAD)
+	{
+		value = 32;
+		nrf24_write(radio,RX_PW_P0 + pipe,&value,1);
+	}
+	
+	value = radio->shadow.reg[EN_RXADDR] | (1 << pipe);
+	nrf24_write(radio,EN_RXADDR,&value,1);
+	return NRF24_OK;
 }
 
-void nrf24_state(uint8_t state)
+void nrf24_close_pipe(nrf24_t *radio, uint8_t pipe)
 {
-	uint8_t config_register;
-	nrf24_read(CONFIG,&config_register,1);
+	uint8_t value = radio->shadow.reg[EN_RXADDR] & ~(1 << pipe);
+	nrf24_write(radio,EN_RXADDR,&value,1);
+}
+
+void nrf24_set_tx_address(nrf24_t *radio, const uint8_t *address)
+{
+	nrf24_write(radio,TX_ADDR,address,5);
+	// ACK comes back on pipe 0 with TX address
+	if (AUTO_ACK) nrf24_write(radio,RX_ADDR_P0,address,5);
+}
+
+void nrf24_set_retries(nrf24_t *radio, uint16_t delay, uint8_t count)
+{
+	uint8_t value;
+	
+	// ARD is in 250us steps starting from 250us, ARC up to 15 retransmits
+	delay = delay > 250 ? (delay - 1) / 250 : 0;
+	if (delay > 15) delay = 15;
+	if (count > 15) count = 15;
+	
+	radio->retry_adaptive = false;
+	value = (delay << ARD) | (count << ARC);
+	nrf24_write(radio,SETUP_RETR,&value,1);
+}
+
+void nrf24_auto_retries(nrf24_t *radio, uint8_t ack_length)
+{
+	uint8_t rf_setup = radio->shadow.reg[RF_SETUP];
+	uint8_t value;
+	
+	// Datasheet minimum ARD for ACK with 'ack_length' byte payload (Table 18):
+	// 250kbps 500us + 250us per 8 bytes, 1mbps 250us up to 5 bytes, 500us up to 15 and 750us above,
+	// 2mbps 250us up to 15 bytes and 500us above
+	if (ack_length > 32) ack_length = 32;
+	if (rf_setup & (1 << RF_DR_LOW)) radio->retry_min_delay = 1 + (ack_length + 7) / 8;
+	else if (rf_setup & (1 << RF_DR_HIGH)) radio->retry_min_delay = ack_length > 15;
+	else radio->retry_min_delay = ack_length > 15 ? 2 : ack_length > 5;
+	
+	// Start from clean link: shortest delay, give up after 3 retransmits
+	radio->retry_adaptive = true;
+	radio->retry_average = 0;
+	radio->retry_count = 0;
+	value = (radio->retry_min_delay << ARD) | (3 << ARC);
+	nrf24_write(radio,SETUP_RETR,&value,1);
+}
+
+uint8_t nrf24_write_ack_payload(nrf24_t *radio, uint8_t pipe, const uint8_t *buffer, uint8_t length)
+{
+	if (!AUTO_ACK) return NRF24_ERR_NO_ACK;
+	if (pipe > 5) return NRF24_ERR_PIPE;
+	if (length == 0 || length > 32) return NRF24_ERR_LENGTH;
+	
+	// ACK payloads share 3-deep TX FIFO, each one goes out with ACK of next message from its pipe
+	if (radio->ack_pending[pipe] >= 3 || (nrf24_status(radio) & (1 << TX_FULL))) return NRF24_ERR_FULL;
+	nrf24_send_payload(radio,W_ACK_PAYLOAD | pipe,buffer,length);
+	radio->ack_pending[pipe]++;
+	return NRF24_OK;
+}
+
+void nrf24_flush_ack_payloads(nrf24_t *radio)
+{
+	nrf24_write(radio,FLUSH_TX,0,0);
+	memset(radio->ack_pending,0,sizeof(radio->ack_pending));
+}
+
+// TX FIFO is about to be flushed, ACK payloads still in it are lost
+static void nrf24_drop_ack_payloads(nrf24_t *radio)
+{
+	for (uint8_t pipe = 0; pipe < 6; pipe++) radio->stats.ack_dropped += radio->ack_pending[pipe];
+	memset(radio->ack_pending,0,sizeof(radio->ack_pending));
+}
+
+static void nrf24_update_config(nrf24_t *radio, uint8_t clear, uint8_t set)
+{
+	uint8_t value;
+	
+	// nrf24_irq() changes CONFIG as well, write only if something changes
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		value = (radio->shadow.reg[CONFIG] & ~clear) | set;
+		if (value != radio->shadow.reg[CONFIG]) nrf24_write(radio,CONFIG,&value,1);
+	}
+}
+
+uint8_t nrf24_sync(nrf24_t *radio)
+{
+	uint8_t value[5], size, mismatches = 0;
+	uint8_t *cached;
 	
+	// Compare chip with RAM copy and write back registers that differ (e.g. after brown-out)
+	for (uint8_t register_address = CONFIG; register_address <= FEATURE; register_address++)
+	{
+		cached = nrf24_shadow(radio,register_address,&size);
+		if (!cached) continue;
+		nrf24_read(radio,register_address,value,size);
+		if (memcmp(value,cached,size))
+		{
+			nrf24_transfer(radio,W_REGISTER | register_address,cached,0,size);
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+void nrf24_state(nrf24_t *radio, uint8_t state)
+{
+	uint8_t value;
+	
+	nrf24_trace(radio,NRF24_TRACE_STATE,state);
 	switch (state)
 	{
 		case POWERUP:
 		// Check if already powered up
-		if (!(config_register & (1 << PWR_UP)))
+		if (!(radio->shadow.reg[CONFIG] & (1 << PWR_UP)))
 		{
-			data = config_register | (1 << PWR_UP);
-			nrf24_write(CONFIG,&data,1);
+			nrf24_update_config(radio,0,(1 << PWR_UP));
 			// 1.5ms from POWERDOWN to start up
-			_delay_ms(2);
+			hal_delay_ms(2);
+			nrf24_stats_state(radio,NRF24_TIME_STANDBY);
 		}
 		break;
 		case POWERDOWN:
-		data = config_register & ~(1 << PWR_UP);
-		nrf24_write(CONFIG,&data,1);
+		nrf24_update_config(radio,(1 << PWR_UP),0);
+		nrf24_stats_state(radio,NRF24_TIME_POWERDOWN);
 		break;
 		case RECEIVE:
-		data = config_register | (1 << PRIM_RX);
-		nrf24_write(CONFIG,&data,1);
+		nrf24_update_config(radio,0,(1 << PRIM_RX));
 		// Clear STATUS register
-		data = (1 << RX_DR) | (1 << TX_DS) | (1 << MAX_RT);
-		nrf24_write(STATUS,&data,1);
+		value = (1 << RX_DR) | (1 << TX_DS) | (1 << MAX_RT);
+		nrf24_write(radio,STATUS,&value,1);
 		break;
 		case TRANSMIT:
-		data = config_register & ~(1 << PRIM_RX);
-		nrf24_write(CONFIG,&data,1);
+		nrf24_update_config(radio,(1 << PRIM_RX),0);
 		break;
 		case STANDBY1:
-		ce_low;
+		ce_low(radio);
 		break;
 		case STANDBY2:
-		data = config_register & ~(1 << PRIM_RX);
-		nrf24_write(CONFIG,&data,1);
-		ce_high;
-		_delay_us(150);
+		nrf24_update_config(radio,(1 << PRIM_RX),0);
+		ce_high(radio);
+		hal_delay_us(150);
 		break;
 	}
 }
 
-void nrf24_start_listening(void)
+void nrf24_start_listening(nrf24_t *radio)
+{
+	radio->listening = true;
+	nrf24_state(radio,RECEIVE);			// Receive mode
+	ce_high(radio);
+	hal_delay_us(150);						// Settling time
+	nrf24_stats_state(radio,NRF24_TIME_RX);
+}
+
+void nrf24_stop_listening(nrf24_t *radio)
+{
+	// Radio stays in STANDBY-I and does not go back to RX after sending
+	radio->listening = false;
+	ce_low(radio);
+	nrf24_stats_state(radio,NRF24_TIME_STANDBY);
+}
+
+uint8_t nrf24_set_channel(nrf24_t *radio, uint8_t channel)
+{
+	if (channel >= NRF24_CHANNELS) return NRF24_ERR_CHANNEL;
+	if (channel == radio->shadow.reg[RF_CH]) return NRF24_OK;
+	
+	// PLL locks to new channel when leaving standby, listening radio goes through STANDBY-I
+	ce_low(radio);
+	nrf24_write(radio,RF_CH,&channel,1);
+	if (radio->listening) ce_high(radio);
+	return NRF24_OK;
+}
+
+void nrf24_scan(nrf24_t *radio, uint8_t *busy, uint8_t sweeps)
+{
+	uint8_t channel = radio->shadow.reg[RF_CH];
+	uint8_t rpd;
+	
+	// Scanning needs RX mode, asynchronous send has to finish first
+	while (radio->tx_busy) hal_idle();
+	memset(busy,0,NRF24_SCAN_BYTES);
+	nrf24_update_config(radio,0,(1 << PRIM_RX));
+	
+	// Channel is busy if RPD (over -64dBm) was seen on any sweep
+	while (sweeps--)
+	{
+		for (uint8_t i = 0; i < NRF24_CHANNELS; i++)
+		{
+			// RPD is cleared when leaving RX, set after 130us settling + 40us in RX.
+			// CE is toggled past trace, sweep would push everything else out of it
+			hal_pin_low(radio->ce_port,radio->ce_mask);
+			nrf24_write(radio,RF_CH,&i,1);
+			hal_pin_high(radio->ce_port,radio->ce_mask);
+			hal_delay_us(NRF24_CARRIER_TIME);
+			nrf24_read(radio,RPD,&rpd,1);
+			if (rpd & 1) busy[i >> 3] |= (1 << (i & 7));
+		}
+	}
+	
+	// Back to own channel, listening or STANDBY-I
+	ce_low(radio);
+	nrf24_write(radio,RF_CH,&channel,1);
+	if (radio->listening) ce_high(radio);
+}
+
+uint8_t nrf24_carrier_begin(nrf24_t *radio)
 {
-	nrf24_state(RECEIVE);				// Receive mode
-	//if (AUTO_ACK) nrf24_write_ack();	// Write acknowledgment
-	ce_high;
-	_delay_us(150);						// Settling time
+	// Sampling needs RX mode, asynchronous send has to finish first
+	if (radio->tx_busy) return 0;
+	nrf24_update_config(radio,0,(1 << PRIM_RX));
+	if (!radio->listening) nrf24_stats_state(radio,NRF24_TIME_RX);
+	
+	// RPD holds since RX was entered, CE low clears it so it shows only carrier
+	// during the 40us after 130us settling
+	ce_low(radio);
+	ce_high(radio);
+	return 1;
 }
 
-uint8_t nrf24_send_message(const void *tx_message)
+uint8_t nrf24_carrier_end(nrf24_t *radio)
 {
-	// For printf();
-	char temp[32];
-	memset(temp,0,32);
-	strcpy(temp,tx_message);
+	uint8_t rpd;
 	
-	// Message length
-	uint8_t length = strlen(tx_message);
+	nrf24_read(radio,RPD,&rpd,1);
+	
+	// Listening radio stays in RX, other one goes back to STANDBY-I
+	if (!radio->listening)
+	{
+		ce_low(radio);
+		nrf24_stats_state(radio,NRF24_TIME_STANDBY);
+	}
+	return rpd & 1;
+}
+
+uint8_t nrf24_carrier(nrf24_t *radio)
+{
+	while (!nrf24_carrier_begin(radio)) hal_idle();
+	hal_delay_us(NRF24_CARRIER_TIME);
+	return nrf24_carrier_end(radio);
+}
 
-	// Transmit mode
-	nrf24_state(TRANSMIT);
+static void nrf24_drain_rx(nrf24_t *radio);
 
-	// Flush TX/RX and clear TX interrupt
-	nrf24_write(FLUSH_RX,0,0);
-	nrf24_write(FLUSH_TX,0,0);
-	data = (1 << TX_DS);
-	nrf24_write(STATUS,&data,1);
+static void nrf24_adapt_retries(nrf24_t *radio, uint8_t status, uint8_t observe)
+{
+	uint8_t retries, delay, count, value;
+	
+	if (!radio->retry_adaptive) return;
 	
-	// Disable interrupt on RX
-	nrf24_read(CONFIG,&data,1);
-	data |= (1 << MASK_RX_DR);
-	nrf24_write(CONFIG,&data,1);
+	// ARC_CNT counts retransmits of last message, MAX_RT counts as worst case.
+	// Average is kept in 1/16 retransmits: avg = 7/8 avg + 1/8 (16 * retries)
+	retries = (status & (1 << MAX_RT)) ? 15 : (observe >> ARC_CNT) & 0x0F;
+	radio->retry_average = radio->retry_average - (radio->retry_average >> 3) + (retries << 1);
 	
-	// Start SPI, load message into TX_PAYLOAD
-	csn_low;
-	if (AUTO_ACK) spi_send(W_TX_PAYLOAD);
-	else spi_send(W_TX_PAYLOAD_NOACK);
-	while (length--) spi_send(*(uint8_t *)tx_message++);
-	spi_send(0);
-	csn_high;
+	// Change settings every 8 messages, right away on lost message
+	if (++radio->retry_count < 8 && !(status & (1 << MAX_RT))) return;
+	radio->retry_count = 0;
+	
+	// Over 1 retransmit per message backs off, under 1/4 goes back towards minimum delay
+	delay = radio->shadow.reg[SETUP_RETR] >> ARD;
+	if (radio->retry_average > 16 && delay < 15) delay++;
+	else if (radio->retry_average < 4 && delay > radio->retry_min_delay) delay--;
+	
+	// Clean link gives up after 3 retransmits, noisy one keeps trying up to 15
+	count = 3 + (radio->retry_average >> 3);
+	if (count > 15) count = 15;
+	
+	value = (delay << ARD) | (count << ARC);
+	if (value != radio->shadow.reg[SETUP_RETR]) nrf24_write(radio,SETUP_RETR,&value,1);
+}
+
+static void nrf24_observe_tx(nrf24_t *radio, uint8_t status)
+{
+	uint8_t observe;
+	
+	// Retransmit counters only mean something with AUTO_ACK
+	if (!AUTO_ACK) return;
+	nrf24_read(radio,OBSERVE_TX,&observe,1);
+	radio->stats.retransmits += (observe >> ARC_CNT) & 0x0F;
+	radio->stats.lost = observe >> PLOS_CNT;
+	nrf24_adapt_retries(radio,status,observe);
+}
+
+static void nrf24_tx_done(nrf24_t *radio, uint8_t status)
+{
+	uint32_t latency = timer_micros() - radio->tx_started;
+	uint8_t bucket = 0;
+	
+	nrf24_trace(radio,NRF24_TRACE_STATUS,status);
+	while (latency && bucket < NRF24_LATENCY_BUCKETS - 1)
+	{
+		latency >>= 1;
+		bucket++;
+	}
+	if (radio->stats.latency[bucket] != 0xFFFF) radio->stats.latency[bucket]++;
+	if (status & (1 << MAX_RT)) radio->stats.max_rt++;
+	nrf24_observe_tx(radio,status);
+}
+
+static void nrf24_finish_tx(nrf24_t *radio, uint8_t status)
+{
+	uint8_t value;
+	
+	// ACK payloads that came back go to RX queue (pipe 0)
+	if (status & (1 << RX_DR))
+	{
+		value = (1 << RX_DR);
+		nrf24_write(radio,STATUS,&value,1);
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) nrf24_drain_rx(radio);
+	}
+	
+	// Interrupt on RX back on, continue listening or stay in STANDBY-I as TX only radio
+	if (radio->listening)
+	{
+		nrf24_update_config(radio,(1 << MASK_RX_DR),(1 << PRIM_RX));
+		nrf24_start_listening(radio);
+	}
+	else
+	{
+		nrf24_update_config(radio,(1 << MASK_RX_DR),0);
+		nrf24_stats_state(radio,NRF24_TIME_STANDBY);
+	}
+}
+
+static uint8_t nrf24_transmit(nrf24_t *radio, uint8_t command, const uint8_t *buffer, uint8_t length)
+{
+	uint8_t status, value;
+	
+	// Wait for asynchronous send to finish
+	while (radio->tx_busy) hal_idle();
+
+	// Flush TX before leaving RX, PTX sends head of TX FIFO even if it is an ACK payload.
+	// Messages in RX FIFO are left for the queue
+	ce_low(radio);
+	nrf24_drop_ack_payloads(radio);
+	nrf24_write(radio,FLUSH_TX,0,0);
+
+	// Transmit mode with interrupt on RX disabled, clear TX interrupt
+	nrf24_update_config(radio,(1 << PRIM_RX),(1 << MASK_RX_DR));
+	value = (1 << TX_DS);
+	nrf24_write(radio,STATUS,&value,1);
+	
+	// Load message into TX_PAYLOAD
+	radio->tx_started = timer_micros();
+	radio->stats.sent++;
+	nrf24_send_payload(radio,command,buffer,length);
 	
 	// Send message by pulling CE high for more than 10us
-	ce_high;
-	_delay_us(15);
-	ce_low;
+	nrf24_stats_state(radio,NRF24_TIME_TX);
+	ce_high(radio);
+	hal_delay_us(15);
+	ce_low(radio);
+	
+	// Wait for message to be sent (TX_DS) or given up on (MAX_RT)
+	status = nrf24_status(radio);
+	while(!(status & ((1 << TX_DS) | (1 << MAX_RT)))) status = nrf24_status(radio);
+	if (status & (1 << MAX_RT))
+	{
+		// Not acknowledged, drop payload
+		nrf24_drop_ack_payloads(radio);
+		nrf24_write(radio,FLUSH_TX,0,0);
+	}
+	
+	// Clear TX_DS or MAX_RT, IRQ has to go high again so next RX_DR gives a new falling edge
+	value = status & ((1 << TX_DS) | (1 << MAX_RT));
+	nrf24_write(radio,STATUS,&value,1);
+	nrf24_tx_done(radio,status);
+	
+	// Radio is left in TX, STATUS tells if ACK payload came back (RX_DR)
+	return status;
+}
+
+uint8_t nrf24_send(nrf24_t *radio, const uint8_t *buffer, uint8_t length)
+{
+	uint8_t status;
+	
+	if (length == 0 || length > 32) return NRF24_ERR_LENGTH;
+	status = nrf24_transmit(radio,AUTO_ACK ? W_TX_PAYLOAD : W_TX_PAYLOAD_NOACK,buffer,length);
+	nrf24_finish_tx(radio,status);
+	
+	if (status & (1 << MAX_RT)) return NRF24_ERR_MAX_RT;
+	return NRF24_OK;
+}
+
+uint8_t nrf24_send_noack(nrf24_t *radio, const uint8_t *buffer, uint8_t length)
+{
+	uint8_t status;
+	
+	// Receiver does not acknowledge even with AUTO_ACK, TX_DS comes as soon as message is out
+	if (length == 0 || length > 32) return NRF24_ERR_LENGTH;
+	status = nrf24_transmit(radio,W_TX_PAYLOAD_NOACK,buffer,length);
+	nrf24_finish_tx(radio,status);
+	return NRF24_OK;
+}
+
+uint8_t nrf24_request(nrf24_t *radio, const uint8_t *buffer, uint8_t length, nrf24_frame *response)
+{
+	uint8_t status, result;
 	
-	// Wait for message to be sent (TX_DS flag raised)
-	nrf24_read(STATUS,&data,1);
-	while(!(data & (1 << TX_DS))) nrf24_read(STATUS,&data,1);
-	printf("Message sent: %s\n",temp);
+	if (length == 0 || length > 32) return NRF24_ERR_LENGTH;
+	status = nrf24_transmit(radio,AUTO_ACK ? W_TX_PAYLOAD : W_TX_PAYLOAD_NOACK,buffer,length);
 	
-	// Enable interrupt on RX
-	nrf24_read(CONFIG,&data,1);
-	data &= ~(1 << MASK_RX_DR);
-	nrf24_write(CONFIG,&data,1);
+	// Answer is the ACK payload, read it before anything else gets into RX FIFO
+	if (status & (1 << MAX_RT)) result = NRF24_ERR_MAX_RT;
+	else if (!(status & (1 << RX_DR))) result = NRF24_ERR_EMPTY;
+	else result = nrf24_read_payload(radio,response->data,&response->length,&response->pipe);
 	
-	// Continue listening
-	nrf24_start_listening();
+	nrf24_finish_tx(radio,status);
+	return result;
+}
+
+uint8_t nrf24_send_message(nrf24_t *radio, const void *tx_message)
+{
+	size_t length = strlen(tx_message);
+	uint8_t result;
 	
+	// Logged, printed later by nrf24_log_flush(). Empty or too long string never goes on air
+	if (length == 0 || length > 32)
+	{
+		nrf24_log("Message not sent: %u bytes, 1 - 32 allowed\n",length,0);
+		return 0;
+	}
+	result = nrf24_send(radio,tx_message,length);
+	if (result == NRF24_ERR_MAX_RT)
+	{
+		nrf24_log("Message not sent: MAX_RT, %u bytes\n",length,0);
+		return 0;
+	}
+	if (result != NRF24_OK)
+	{
+		nrf24_log("Message not sent: error %u, %u bytes\n",result,length);
+		return 0;
+	}
+	nrf24_log("Message sent: %u bytes\n",length,0);
 	return 1;
 }
 
-unsigned int nrf24_available(void)
+static void nrf24_drain_rx(nrf24_t *radio)
 {
-	uint8_t config_register;
-	nrf24_read(FIFO_STATUS,&config_register,1);
-	if (!(config_register & (1 << RX_EMPTY))) return 1;
-	return 0;
+	// Called from ISR or with interrupts disabled, so there is only one producer
+	nrf24_frame *frame;
+	uint8_t fifo;
+	
+	// RX_FULL: all 3 RX FIFO levels taken, chip drops what comes meanwhile
+	radio->rx_pending = false;
+	nrf24_read(radio,FIFO_STATUS,&fifo,1);
+	if (fifo & (1 << RX_FULL)) radio->stats.rx_full++;
+	while (1)
+	{
+		if ((uint8_t)(radio->rx_head - radio->rx_tail) == RX_QUEUE_SIZE)
+		{
+			// Leave the rest in RX FIFO until consumer makes room
+			radio->rx_pending = true;
+			radio->stats.queue_full++;
+			return;
+		}
+		
+		// Read straight into the queue slot until RX FIFO is empty
+		frame = &radio->rx_queue[radio->rx_head & (RX_QUEUE_SIZE - 1)];
+		if (nrf24_read_payload(radio,frame->data,&frame->length,&frame->pipe) != NRF24_OK) return;
+		radio->rx_head++;
+		radio->stats.received++;
+		
+		// Message was acknowledged with ACK payload waiting for its pipe
+		if (radio->ack_pending[frame->pipe]) radio->ack_pending[frame->pipe]--;
+	}
 }
 
-const char * nrf24_read_message(void)
+void nrf24_on_receive(nrf24_t *radio, nrf24_rx_callback callback)
 {
-	// Message placeholder
-	static char rx_message[32];
-	memset(rx_message,0,32);
+	radio->rx_callback = callback;
+}
+
+static void nrf24_async_loaded(struct spi_transfer *transfer)
+{
+	nrf24_t *radio = (nrf24_t *)((uint8_t *)transfer - offsetof(nrf24_t,async_payload));
+	radio->status = transfer->status;
+	
+	// Message is in TX FIFO, leave CE high and nrf24_irq() finishes the job on TX_DS or MAX_RT
+	ce_high(radio);
+}
+
+uint8_t nrf24_send_async(nrf24_t *radio, const uint8_t *buffer, uint8_t length, nrf24_tx_callback callback)
+{
+	uint8_t pad = DYN_PAYLOAD ? 0 : 32 - length;
+	
+	if (radio->tx_busy || length == 0 || length > 32) return 0;
+	radio->tx_busy = true;
+	radio->tx_callback = callback;
 	
-	// Write ACK message
-	if (AUTO_ACK) nrf24_write_ack();
+	// Transmit mode, CE low while payload is loaded
+	ce_low(radio);
+	nrf24_state(radio,TRANSMIT);
+	radio->tx_started = timer_micros();
+	radio->stats.sent++;
+	radio->stats.spi_bytes += 1 + 2 + length + pad + 1;
+	nrf24_stats_state(radio,NRF24_TIME_TX);
 	
-	// Get length of incoming message
-	nrf24_read(R_RX_PL_WID,&data,1);
+	// Flush TX (ACK payloads in it would go out first), clear TX interrupts and load message
+	// without waiting for SPI, buffer has to stay untouched until callback. CE stays low until then
+	nrf24_drop_ack_payloads(radio);
+	nrf24_trace(radio,NRF24_TRACE_FLUSH,FLUSH_TX);
+	radio->async_flush = (struct spi_transfer){ .command = FLUSH_TX };
+	nrf24_submit_spi(radio,&radio->async_flush);
+	radio->async_clear_value = (1 << TX_DS) | (1 << MAX_RT);
+	radio->async_clear = (struct spi_transfer){ .command = W_REGISTER | STATUS, .tx = &radio->async_clear_value, .length = 1 };
+	nrf24_submit_spi(radio,&radio->async_clear);
+	radio->async_payload = (struct spi_transfer){ .command = AUTO_ACK ? W_TX_PAYLOAD : W_TX_PAYLOAD_NOACK, .tx = buffer, .length = length, .pad = pad, .complete = nrf24_async_loaded };
+	nrf24_submit_spi(radio,&radio->async_payload);
 	
-	// Read message
-	if (data > 0) nrf24_send_spi(R_RX_PAYLOAD,&rx_message,data+1);
+	return 1;
+}
+
+uint8_t nrf24_busy(nrf24_t *radio)
+{
+	return radio->tx_busy;
+}
+
+uint8_t nrf24_async_result(nrf24_t *radio)
+{
+	return radio->tx_result;
+}
 
-	// Check if there is message in array
-	if (strlen(rx_message) > 0)
+void nrf24_irq(nrf24_t *radio)
+{
+	uint8_t status, value;
+	
+	status = nrf24_status(radio);
+	nrf24_trace(radio,NRF24_TRACE_IRQ,status);
+	
+	// Blocking send/stream masks RX_DR and reads ACK payloads itself (nrf24_request needs its answer)
+	if (radio->shadow.reg[CONFIG] & (1 << MASK_RX_DR)) status &= ~(1 << RX_DR);
+	
+	// Clear flags that were seen, so next event gives new falling edge on IRQ.
+	// TX flags belong to blocking send/stream unless asynchronous send is running
+	value = status & (1 << RX_DR);
+	if (radio->tx_busy) value |= status & ((1 << TX_DS) | (1 << MAX_RT));
+	if (value) nrf24_write(radio,STATUS,&value,1);
+	
+	if (radio->tx_busy && (status & ((1 << TX_DS) | (1 << MAX_RT))))
 	{
-		// Clear RX interrupt
-		data = (1 << RX_DR);
-		nrf24_write(STATUS,&data,1);
+		// Not acknowledged, drop payload
+		if (status & (1 << MAX_RT))
+		{
+			nrf24_drop_ack_payloads(radio);
+			nrf24_write(radio,FLUSH_TX,0,0);
+		}
+		
+		// Back to listening with CE still high, or STANDBY-I as TX only radio
+		if (radio->listening) nrf24_update_config(radio,0,(1 << PRIM_RX));
+		else ce_low(radio);
+		nrf24_stats_state(radio,radio->listening ? NRF24_TIME_RX : NRF24_TIME_STANDBY);
 		
-		return rx_message;
+		nrf24_tx_done(radio,status);
+		radio->tx_result = (status & (1 << MAX_RT)) ? NRF24_ERR_MAX_RT : NRF24_OK;
+		radio->tx_busy = false;
+		if (radio->tx_callback) radio->tx_callback(radio,!(status & (1 << MAX_RT)));
 	}
 	
-	// Clear RX interrupt
-	data = (1 << RX_DR);
-	nrf24_write(STATUS,&data,1);
+	if (status & (1 << RX_DR))
+	{
+		nrf24_drain_rx(radio);
+		if (radio->rx_callback) radio->rx_callback(radio);
+	}
+}
+
+static void nrf24_stream_check(nrf24_t *radio, uint8_t status)
+{
+	uint8_t value;
+	
+	// Payload not acknowledged, drop rest of the FIFO so stream keeps moving
+	if (status & (1 << MAX_RT))
+	{
+		nrf24_drop_ack_payloads(radio);
+		nrf24_write(radio,FLUSH_TX,0,0);
+		value = (1 << MAX_RT);
+		nrf24_write(radio,STATUS,&value,1);
+		radio->stream_failed = true;
+		radio->stats.max_rt++;
+	}
+}
+
+void nrf24_stream_begin(nrf24_t *radio)
+{
+	uint8_t value;
+	
+	// Wait for asynchronous send to finish
+	while (radio->tx_busy) hal_idle();
+	radio->stream_failed = false;
+	
+	// Stream needs whole TX FIFO, flush it before leaving RX
+	ce_low(radio);
+	nrf24_drop_ack_payloads(radio);
+	nrf24_write(radio,FLUSH_TX,0,0);
+	
+	// Transmit mode with interrupt on RX disabled, clear TX interrupts
+	nrf24_update_config(radio,(1 << PRIM_RX),(1 << MASK_RX_DR));
+	value = (1 << TX_DS) | (1 << MAX_RT);
+	nrf24_write(radio,STATUS,&value,1);
+	
+	// Keep CE high, chip sends whatever is in TX FIFO and waits in STANDBY-II when empty
+	// (nRF24L01 without + must not stay in TX mode for more than 4ms)
+	nrf24_state(radio,STANDBY2);
+	nrf24_stats_state(radio,NRF24_TIME_TX);
+}
+
+static uint8_t nrf24_stream_load(nrf24_t *radio, uint8_t command, const uint8_t *buffer, uint8_t length)
+{
+	uint8_t status;
+	
+	if (length == 0 || length > 32) return 0;
+	
+	// Wait for free slot in TX FIFO
+	status = nrf24_status(radio);
+	while (status & (1 << TX_FULL))
+	{
+		nrf24_stream_check(radio,status);
+		status = nrf24_status(radio);
+	}
+	nrf24_stream_check(radio,status);
+	
+	// Load message into TX_PAYLOAD, CE is already high so it goes out right away
+	radio->stats.sent++;
+	nrf24_send_payload(radio,command,buffer,length);
+	
+	return 1;
+}
+
+uint8_t nrf24_stream_push(nrf24_t *radio, const uint8_t *buffer, uint8_t length)
+{
+	return nrf24_stream_load(radio,AUTO_ACK ? W_TX_PAYLOAD : W_TX_PAYLOAD_NOACK,buffer,length);
+}
+
+uint8_t nrf24_stream_push_noack(nrf24_t *radio, const uint8_t *buffer, uint8_t length)
+{
+	// Goes out without waiting for ACK even with AUTO_ACK
+	return nrf24_stream_load(radio,W_TX_PAYLOAD_NOACK,buffer,length);
+}
+
+uint8_t nrf24_stream_end(nrf24_t *radio)
+{
+	uint8_t status, fifo, value;
+	
+	// Wait for TX FIFO to drain, STATUS comes with FIFO_STATUS read
+	status = nrf24_read(radio,FIFO_STATUS,&fifo,1);
+	while (!(fifo & (1 << TX_EMPTY)))
+	{
+		nrf24_stream_check(radio,status);
+		status = nrf24_read(radio,FIFO_STATUS,&fifo,1);
+	}
+	nrf24_stream_check(radio,status);
+	nrf24_state(radio,STANDBY1);
+	
+	// Clear TX interrupt
+	value = (1 << TX_DS);
+	nrf24_write(radio,STATUS,&value,1);
+	
+	// Retransmits of last message in stream
+	nrf24_observe_tx(radio,status);
+	nrf24_finish_tx(radio,status);
+	
+	return !radio->stream_failed;
+}
+
+unsigned int nrf24_available(nrf24_t *radio)
+{
+	// Pick up messages nrf24_irq() has not (IRQ not used or queue was full)
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) nrf24_drain_rx(radio);
+	return radio->rx_head != radio->rx_tail;
+}
+
+nrf24_frame * nrf24_peek(nrf24_t *radio)
+{
+	// Oldest message stays in the queue until nrf24_release()
+	if (radio->rx_head == radio->rx_tail) return 0;
+	return &radio->rx_queue[radio->rx_tail & (RX_QUEUE_SIZE - 1)];
+}
+
+void nrf24_release(nrf24_t *radio)
+{
+	if (radio->rx_head == radio->rx_tail) return;
+	radio->rx_tail++;
+	
+	// There is room again for messages left in RX FIFO
+	if (radio->rx_pending) ATOMIC_BLOCK(ATOMIC_RESTORESTATE) nrf24_drain_rx(radio);
+}
+
+uint8_t nrf24_receive(nrf24_t *radio, nrf24_frame *frame)
+{
+	nrf24_frame *next = nrf24_peek(radio);
+	if (!next) return 0;
+	memcpy(frame,next,sizeof(nrf24_frame));
+	nrf24_release(radio);
+	return 1;
+}
+
+void nrf24_on_pipe(nrf24_t *radio, uint8_t pipe, nrf24_pipe_handler handler)
+{
+	if (pipe < 6) radio->pipe_handler[pipe] = handler;
+}
+
+uint8_t nrf24_dispatch(nrf24_t *radio)
+{
+	nrf24_frame *frame;
+	uint8_t count = 0;
+	
+	// Hand every queued message to handler of pipe it arrived on, messages without handler are dropped
+	while ((frame = nrf24_peek(radio)))
+	{
+		if (frame->pipe < 6 && radio->pipe_handler[frame->pipe]) radio->pipe_handler[frame->pipe](radio,frame);
+		nrf24_release(radio);
+		count++;
+	}
+	return count;
+}
+
+const char * nrf24_read_message(nrf24_t *radio)
+{
+	// Message placeholder
+	static char rx_message[33];
+	nrf24_frame frame;
+	
+	if (!nrf24_available(radio)) return "failed";
 	
-	return "failed";
+	nrf24_receive(radio,&frame);
+	memcpy(rx_message,frame.data,frame.length);
+	rx_message[frame.length] = 0;
+	return rx_message;
 }
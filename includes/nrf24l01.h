@@ -23,6 +23,10 @@
 #ifndef _NRF24L01_H
 #define _NRF24L01_H
 
+#include <stdint.h>
+#include <stdbool.h>
+#include "spi.h"
+
 //	States
 #define POWERUP		1
 #define POWERDOWN	2
@@ -31,15 +35,206 @@
 #define STANDBY1	5
 #define STANDBY2	6
 
+//	Return codes
+#define NRF24_OK			0
+#define NRF24_ERR_LENGTH	1	// Length is 0 or more than 32 bytes
+#define NRF24_ERR_FULL		2	// TX FIFO is full
+#define NRF24_ERR_EMPTY		3	// RX FIFO is empty
+#define NRF24_ERR_CORRUPT	4	// RX FIFO reported invalid length and was flushed
+#define NRF24_ERR_MAX_RT	5	// Not acknowledged after all re-transmits
+#define NRF24_ERR_PIPE		6	// Pipe number is not 0 - 5
+#define NRF24_ERR_NO_CHIP	7	// Chip did not answer after power on
+#define NRF24_ERR_NO_ACK	8	// Needs AUTO_ACK
+#define NRF24_ERR_CHANNEL	9	// Channel over 125
+#define NRF24_ERR_NO_ROUTE	10	// No route to destination (nrf24l01-mesh.c)
+#define NRF24_ERR_BUSY		11	// Channel stayed busy (nrf24l01-csma.c)
+
+//	Channels 0 - 125 (2400 - 2525MHz), nrf24_scan() marks busy ones in 16 byte bitmap
+#define NRF24_CHANNELS		126
+#define NRF24_SCAN_BYTES	((NRF24_CHANNELS + 7) / 8)
+#define NRF24_CHANNEL_BUSY(map, channel)	((map)[(channel) >> 3] & (1 << ((channel) & 7)))
+
+//	RPD shows carrier this long (us) after entering RX: 130us settling + 40us
+#define NRF24_CARRIER_TIME	170
+
+//	Number of received messages buffered between nrf24_irq() and main loop (power of 2, max 128)
+#ifndef RX_QUEUE_SIZE
+#define RX_QUEUE_SIZE	4
+#endif
+
+//	Driver log entries are queued (format in flash and two numbers) and printed by
+//	nrf24_log_flush() from main loop, so UART never holds up the radio. -DNRF24_LOG=0 removes them
+#ifndef NRF24_LOG
+#define NRF24_LOG		1
+#endif
+#ifndef NRF24_LOG_SIZE
+#define NRF24_LOG_SIZE	8			// Entries (power of 2)
+#endif
+
+#if NRF24_LOG
+#define nrf24_log(format, a, b)	nrf24_log_P(PSTR(format), (a), (b))
+#else
+#define nrf24_log(format, a, b)	do {} while (0)
+#endif
+
+//	Received message, 'pipe' is RX_P_NO it arrived on. Without DYN_PAYLOAD every message is
+//	sent padded with zeros to 32 bytes, so 'length' is always 32 and layers on top have to carry
+//	the real length themselves
+typedef struct
+{
+	uint8_t length;
+	uint8_t pipe;
+	uint8_t data[32];
+} nrf24_frame;
+
+//	Link statistics, time is counted per state in ms and send latency (load to TX_DS/MAX_RT)
+//	in log2 buckets: bucket n holds 2^(n-1) - 2^n - 1 us, last one everything above
+#define NRF24_LATENCY_BUCKETS	16
+#define NRF24_TIME_RX			0
+#define NRF24_TIME_TX			1
+#define NRF24_TIME_STANDBY		2
+#define NRF24_TIME_POWERDOWN	3
+
+typedef struct
+{
+	uint32_t sent;					// Messages loaded for sending
+	uint32_t max_rt;				// Not acknowledged after all retransmits
+	uint32_t retransmits;			// Sum of ARC_CNT
+	uint8_t lost;					// PLOS_CNT after last send (saturates at 15, reset by RF_CH write)
+	uint32_t received;
+	uint16_t rx_full;				// RX FIFO full (FIFO_STATUS RX_FULL) when drain started
+	uint16_t queue_full;			// Queue was full, messages left waiting in RX FIFO
+	uint16_t ack_dropped;			// ACK payloads flushed from TX FIFO by a send before they went out
+	uint32_t spi_bytes;
+	uint32_t time[4];				// ms in RX, TX, STANDBY, POWERDOWN
+	uint16_t latency[NRF24_LATENCY_BUCKETS];
+} nrf24_stats;
+
+typedef struct nrf24 nrf24_t;
+
+//	IRQ callbacks, TX result is 1 when sent and 0 on MAX_RT
+typedef void (*nrf24_tx_callback)(nrf24_t *radio, uint8_t result);
+typedef void (*nrf24_rx_callback)(nrf24_t *radio);
+typedef void (*nrf24_pipe_handler)(nrf24_t *radio, nrf24_frame *frame);
+
+//	RAM copy of writable configuration registers
+typedef struct
+{
+	uint8_t reg[7];					// CONFIG, EN_AA, EN_RXADDR, SETUP_AW, SETUP_RETR, RF_CH, RF_SETUP
+	uint8_t dynpd;
+	uint8_t feature;
+	uint8_t rx_addr_p0[5];
+	uint8_t rx_addr_p1[5];
+	uint8_t rx_addr_p2[4];			// LSB of pipes 2 - 5
+	uint8_t tx_addr[5];
+} nrf24_registers;
+
+//	One nRF24L01+, radios on the same SPI bus differ by CE, CSN and IRQ.
+//	Only pins are set up front (see NRF24_RADIO), the rest belongs to the library.
+struct nrf24
+{
+	volatile uint8_t *ce_port;
+	uint8_t ce_mask;
+	volatile uint8_t *csn_port;
+	uint8_t csn_mask;
+	uint8_t irq;					// External interrupt IRQ pin is connected to (0 = INT0/PD2, 1 = INT1/PD3)
+	
+	nrf24_registers shadow;			// State changes are single writes instead of read-modify-write
+	volatile uint8_t status;		// STATUS shifted out by the chip with the last command
+	bool listening;					// Go back to RX after sending
+	bool stream_failed;				// Message hit MAX_RT during streaming
+	
+	// Retransmit delay/count follow OBSERVE_TX (see nrf24_auto_retries)
+	bool retry_adaptive;
+	uint8_t retry_min_delay;		// Datasheet minimum ARD for data rate and ACK payload size
+	uint8_t retry_average;			// Retransmits per message in 1/16
+	uint8_t retry_count;			// Messages since last change
+	
+	// IRQ callbacks and asynchronous send in progress
+	nrf24_tx_callback tx_callback;
+	nrf24_rx_callback rx_callback;
+	volatile bool tx_busy;
+	volatile uint8_t tx_result;		// NRF24_OK or NRF24_ERR_MAX_RT, last asynchronous send
+	nrf24_pipe_handler pipe_handler[6];
+	
+	// Non-blocking SPI transfers used by nrf24_send_async()
+	struct spi_transfer async_flush, async_clear, async_payload;
+	uint8_t async_clear_value;
+	
+	// RX queue, filled by nrf24_irq() (producer) and emptied by main loop (consumer)
+	nrf24_frame rx_queue[RX_QUEUE_SIZE];
+	volatile uint8_t rx_head;		// Written only by producer
+	volatile uint8_t rx_tail;		// Written only by consumer
+	volatile bool rx_pending;		// Queue was full and RX FIFO still has messages
+	
+	uint8_t ack_pending[6];			// ACK payloads loaded per pipe
+	uint8_t frag_id;				// Id of last message sent by nrf24_frag_send()
+	
+	// Statistics, time uses timer_micros() from timer.c
+	nrf24_stats stats;
+	uint8_t stats_state;			// NRF24_TIME_* radio is in
+	uint32_t stats_since;			// timer_micros() state time is counted from
+	uint32_t tx_started;			// timer_micros() of last send
+};
+
+//	Radio with CE on e.g. PORTB/PB1, CSN on PORTB/PB2 and IRQ on INT0:
+//	nrf24_t radio = NRF24_RADIO(PORTB, PB1, PORTB, PB2, 0);
+#define NRF24_RADIO(ce_port_register, ce_pin, csn_port_register, csn_pin, irq_number) \
+	{ .ce_port = &(ce_port_register), .ce_mask = (1 << (ce_pin)), \
+	  .csn_port = &(csn_port_register), .csn_mask = (1 << (csn_pin)), .irq = (irq_number) }
+
 //	Forward declarations
-uint8_t nrf24_send_spi(uint8_t register_address, void *data, unsigned int bytes);
-uint8_t nrf24_write(uint8_t register_address, uint8_t *data, unsigned int bytes);
-uint8_t nrf24_read(uint8_t register_address, uint8_t *data, unsigned int bytes);
-void nrf24_init(void);
-void nrf24_state(uint8_t state);
-void nrf24_start_listening(void);
-unsigned int nrf24_available(void);
-const char * nrf24_read_message(void);
-uint8_t nrf24_send_message(const void *tx_message);
+void nrf24_submit_spi(nrf24_t *radio, struct spi_transfer *transfer);
+uint8_t nrf24_send_spi(nrf24_t *radio, uint8_t register_address, void *data, unsigned int bytes);
+uint8_t nrf24_write(nrf24_t *radio, uint8_t register_address, const uint8_t *data, unsigned int bytes);
+uint8_t nrf24_read(nrf24_t *radio, uint8_t register_address, uint8_t *data, unsigned int bytes);
+uint8_t nrf24_status(nrf24_t *radio);
+uint8_t nrf24_last_status(nrf24_t *radio);
+uint8_t nrf24_status_pipe(nrf24_t *radio);
+uint8_t nrf24_status_tx_full(nrf24_t *radio);
+uint8_t nrf24_status_rx_ready(nrf24_t *radio);
+uint8_t nrf24_write_payload(nrf24_t *radio, const uint8_t *buffer, uint8_t length);
+uint8_t nrf24_read_payload(nrf24_t *radio, uint8_t *buffer, uint8_t *length, uint8_t *pipe);
+uint8_t nrf24_init(nrf24_t *radio);
+uint8_t nrf24_open_pipe(nrf24_t *radio, uint8_t pipe, const uint8_t *address);
+void nrf24_close_pipe(nrf24_t *radio, uint8_t pipe);
+void nrf24_set_tx_address(nrf24_t *radio, const uint8_t *address);
+uint8_t nrf24_set_channel(nrf24_t *radio, uint8_t channel);
+void nrf24_scan(nrf24_t *radio, uint8_t *busy, uint8_t sweeps);
+uint8_t nrf24_carrier(nrf24_t *radio);
+uint8_t nrf24_carrier_begin(nrf24_t *radio);
+uint8_t nrf24_carrier_end(nrf24_t *radio);
+void nrf24_set_retries(nrf24_t *radio, uint16_t delay, uint8_t count);
+void nrf24_auto_retries(nrf24_t *radio, uint8_t ack_length);
+uint8_t nrf24_write_ack_payload(nrf24_t *radio, uint8_t pipe, const uint8_t *buffer, uint8_t length);
+void nrf24_flush_ack_payloads(nrf24_t *radio);
+void nrf24_state(nrf24_t *radio, uint8_t state);
+uint8_t nrf24_sync(nrf24_t *radio);
+void nrf24_start_listening(nrf24_t *radio);
+void nrf24_stop_listening(nrf24_t *radio);
+unsigned int nrf24_available(nrf24_t *radio);
+nrf24_frame * nrf24_peek(nrf24_t *radio);
+void nrf24_release(nrf24_t *radio);
+uint8_t nrf24_receive(nrf24_t *radio, nrf24_frame *frame);
+void nrf24_on_pipe(nrf24_t *radio, uint8_t pipe, nrf24_pipe_handler handler);
+uint8_t nrf24_dispatch(nrf24_t *radio);
+const char * nrf24_read_message(nrf24_t *radio);
+uint8_t nrf24_send(nrf24_t *radio, const uint8_t *buffer, uint8_t length);
+uint8_t nrf24_send_noack(nrf24_t *radio, const uint8_t *buffer, uint8_t length);
+uint8_t nrf24_send_message(nrf24_t *radio, const void *tx_message);
+uint8_t nrf24_request(nrf24_t *radio, const uint8_t *buffer, uint8_t length, nrf24_frame *response);
+void nrf24_stream_begin(nrf24_t *radio);
+uint8_t nrf24_stream_push(nrf24_t *radio, const uint8_t *buffer, uint8_t length);
+uint8_t nrf24_stream_push_noack(nrf24_t *radio, const uint8_t *buffer, uint8_t length);
+uint8_t nrf24_stream_end(nrf24_t *radio);
+void nrf24_on_receive(nrf24_t *radio, nrf24_rx_callback callback);
+uint8_t nrf24_send_async(nrf24_t *radio, const uint8_t *buffer, uint8_t length, nrf24_tx_callback callback);
+uint8_t nrf24_busy(nrf24_t *radio);
+uint8_t nrf24_async_result(nrf24_t *radio);
+void nrf24_irq(nrf24_t *radio);
+void nrf24_get_stats(nrf24_t *radio, nrf24_stats *stats);
+void nrf24_clear_stats(nrf24_t *radio);
+void nrf24_log_P(const char *format, uint16_t a, uint16_t b);
+uint8_t nrf24_log_flush(void);
 
 #endif /*_NRF24L01_H*/
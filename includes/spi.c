@@ -16,6 +16,7 @@
 #include <avr/common.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <util/atomic.h>
 #include "spi.h"
 
 #define DDR_SPI		DDRB
@@ -23,6 +24,11 @@
 #define DD_MISO		DDB4
 #define DD_SCK		DDB5
 
+/* Transaction engine: queue of submitted transfers, head is the one on the wire */
+static struct spi_transfer *volatile queue_head;
+static struct spi_transfer *queue_tail;
+static uint8_t position;				/* Bytes of current transfer done, 0 while command is on the wire */
+
 void spi_master_init( void )
 {
 	DDR_SPI &= ~_BV(DD_MISO);
@@ -86,7 +92,8 @@ void spi_master_init( void )
 	SPSR |= _BV(SPI2X);
 }
 
-void spi_bulk_send( uint8_t *send_buffer, uint8_t count )
+/* Blocking helpers talk to SPDR directly, they must not be used while spi_busy() */
+void spi_bulk_send( const uint8_t *send_buffer, uint8_t count )
 {
 	while ( count-- ) {
 		SPDR = *send_buffer++;
@@ -115,3 +122,75 @@ uint8_t spi_exchange( uint8_t send_data )
 	loop_until_bit_is_set(SPSR, SPIF);
 	return SPDR;
 }
+
+static void spi_start( struct spi_transfer *transfer )
+{
+	if ( transfer->csn_port ) *transfer->csn_port &= ~transfer->csn_mask;
+	position = 0;
+	SPCR |= _BV(SPIE);
+	SPDR = transfer->command;
+}
+
+static void spi_service( void )
+{
+	struct spi_transfer *transfer = queue_head;
+	uint8_t received = SPDR;
+
+	if ( position == 0 ) transfer->status = received;
+	else if ( transfer->rx && position <= transfer->length ) transfer->rx[position - 1] = received;
+
+	if ( position < transfer->length ) {
+		SPDR = transfer->tx ? transfer->tx[position] : 0xFF;
+		position++;
+		return;
+	}
+	if ( position < transfer->length + transfer->pad ) {
+		SPDR = 0;
+		position++;
+		return;
+	}
+
+	/* Transfer finished, next one goes on the wire before completion callback can queue more */
+	if ( transfer->csn_port ) *transfer->csn_port |= transfer->csn_mask;
+	queue_head = transfer->next;
+	if ( queue_head ) spi_start( queue_head );
+	else SPCR &= ~_BV(SPIE);
+	transfer->done = 1;
+	if ( transfer->complete ) transfer->complete( transfer );
+}
+
+ISR(SPI_STC_vect)
+{
+	spi_service();
+}
+
+void spi_submit( struct spi_transfer *transfer )
+{
+	transfer->done = 0;
+	transfer->next = 0;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if ( queue_head ) {
+			queue_tail->next = transfer;
+			queue_tail = transfer;
+		} else {
+			queue_head = queue_tail = transfer;
+			spi_start( transfer );
+		}
+	}
+}
+
+void spi_wait( struct spi_transfer *transfer )
+{
+	/* With interrupts disabled (e.g. inside another ISR) SPIF is polled here instead of waiting for the ISR. Reading SPSR
+	 * with SPIF set followed by SPDR access clears the flag, so the ISR does not run for the same byte again. */
+	while ( !transfer->done ) {
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			if ( queue_head && bit_is_set(SPSR, SPIF) ) spi_service();
+		}
+	}
+}
+
+uint8_t spi_busy( void )
+{
+	return queue_head != 0;
+}
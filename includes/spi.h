@@ -15,10 +15,31 @@
 
 #ifndef __SMALL_SPI_H__
 #define __SMALL_SPI_H__
-#include <avr/common.h>
+#include <stdint.h>
+
+/* Queued SPI transaction. Command byte is sent first with CSN pulled low, then 'length' bytes from 'tx'
+ * (0xFF when NULL) while received bytes are stored into 'rx' (discarded when NULL), then 'pad' zero bytes.
+ * 'tx' and 'rx' may point to the same buffer. Descriptor and buffers belong to the caller and must stay valid
+ * until 'done' is set. */
+struct spi_transfer {
+	uint8_t command;
+	const uint8_t *tx;
+	uint8_t *rx;
+	uint8_t length;
+	uint8_t pad;						/* Zero bytes clocked out after 'length', nothing is stored */
+	volatile uint8_t *csn_port;			/* CSN is left alone when NULL */
+	uint8_t csn_mask;
+	void ( *complete )( struct spi_transfer *transfer );	/* Called from ISR, may submit new transfers */
+	uint8_t status;						/* Byte received while command was sent */
+	volatile uint8_t done;
+	struct spi_transfer *next;
+};
 
 void spi_master_init( void );
-void spi_bulk_send( uint8_t *send_buffer, uint8_t count );
+void spi_submit( struct spi_transfer *transfer );
+void spi_wait( struct spi_transfer *transfer );
+uint8_t spi_busy( void );
+void spi_bulk_send( const uint8_t *send_buffer, uint8_t count );
 void spi_send( uint8_t send_data );
 void spi_bulk_exchange( uint8_t *send_buffer, uint8_t *receive_buffer, uint8_t count );
 uint8_t spi_exchange( uint8_t send_data );
@@ -0,0 +1,82 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Set clock frequency
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#include "timer.h"
+
+// Timer0 clock is F_CPU / 64 (4us at 16MHz), compare match every 1ms
+#define TIMER_TOP			(F_CPU / TIMER_PRESCALER / 1000UL - 1)
+
+static volatile uint32_t millis;
+
+void timer_init(void)
+{
+	TCCR0A = (1 << WGM01);					// CTC, TOP = OCR0A
+	TCCR0B = (1 << CS01) | (1 << CS00);		// Prescaler 64
+	OCR0A = TIMER_TOP;
+	TIMSK0 |= (1 << OCIE0A);
+}
+
+ISR(TIMER0_COMPA_vect)
+{
+	millis++;
+}
+
+uint32_t timer_millis(void)
+{
+	uint32_t value;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) value = millis;
+	return value;
+}
+
+uint32_t timer_micros(void)
+{
+	uint32_t value;
+	uint8_t ticks;
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		value = millis;
+		ticks = TCNT0;
+		// Compare match happened but ISR did not run yet
+		if ((TIFR0 & (1 << OCF0A)) && ticks < TIMER_TOP) value++;
+	}
+	return value * 1000UL + ticks * TIMER_PRESCALER / (F_CPU / 1000000UL);
+}
+
+void timer_raw(uint16_t *ms, uint8_t *ticks)
+{
+	uint16_t value = millis;
+	
+	*ticks = TCNT0;
+	// Compare match happened but ISR did not run yet
+	if ((TIFR0 & (1 << OCF0A)) && *ticks < TIMER_TOP) value++;
+	*ms = value;
+}
@@ -0,0 +1,45 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef _TIMER_H
+#define _TIMER_H
+
+#include <stdint.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+//	Timer0 runs in CTC mode with interrupt every 1ms, time since timer_init().
+//	It counts one tick every TIMER_PRESCALER cycles (TIMER_TICK_NS, 4000ns at 16MHz)
+#define TIMER_PRESCALER		64UL
+#define TIMER_TICK_NS		(TIMER_PRESCALER * 1000000000UL / F_CPU)
+
+void timer_init(void);
+uint32_t timer_millis(void);
+uint32_t timer_micros(void);
+
+//	Low 16 bits of ms count and ticks into current ms, without multiply or critical section
+//	of its own for cheap timestamps. Call with interrupts disabled
+void timer_raw(uint16_t *millis, uint8_t *ticks);
+
+#endif /*_TIMER_H*/
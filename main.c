@@ -39,7 +39,7 @@
 #include <stdio.h>
 #include <string.h>
 
-//	Set up UART for printf();
+//	Set up UART for printf(), characters go out from UDRE interrupt (STDIO_UART.h)
 #ifndef BAUD
 #define BAUD 9600
 #endif
@@ -49,69 +49,101 @@
 #include "nrf24l01.h"
 #include "nrf24l01-mnemonics.h"
 #include "spi.h"
-void print_config(void);
+#include "timer.h"
+void print_config(nrf24_t *radio);
+void message_ready(nrf24_t *radio);
+
+//	nRF24L01+ with CE on PB1, CSN on PB2 and IRQ on PD2 (INT0)
+nrf24_t radio = NRF24_RADIO(PORTB, PB1, PORTB, PB2, 0);
 
 //	Used in IRQ ISR
 volatile bool message_received = false;
-volatile bool status = false;
+uint8_t status;
+bool reply_with_ack;
 
 int main(void)
 {	
 	//	Set cliche message to send (message cannot exceed 32 characters)
 	char tx_message[32];				// Define string array
 	strcpy(tx_message,"Hello World!");	// Copy string into array
+	nrf24_frame rx_frame;				// Received message
 	
 	//	Initialize UART
 	uart_init();
 	
+	//	Time base for link statistics
+	timer_init();
+	
 	//	Initialize nRF24L01+ and print configuration info
-    nrf24_init();
-	print_config();
+    nrf24_init(&radio);
+	print_config(&radio);
 	
 	//	Start listening to incoming messages
-	nrf24_start_listening();
+	nrf24_on_receive(&radio,message_ready);
+	nrf24_start_listening(&radio);
+	
+	//	Preload answer, it goes out with ACK of first message
+	reply_with_ack = (nrf24_write_ack_payload(&radio,0,(uint8_t *)tx_message,strlen(tx_message)) == NRF24_OK);
 	
     while (1) 
     {
 		if (message_received)
 		{
-			//	Message received, print it
+			//	Messages received, print them
 			message_received = false;
-			printf("Received message: %s\n",nrf24_read_message());
-			//	Send message as response
-			_delay_ms(500);
-			status = nrf24_send_message(tx_message);
-			if (status == true) printf("Message sent successfully\n");
+			while (nrf24_receive(&radio,&rx_frame))
+			{
+				printf("Received message: %.*s\n",rx_frame.length,(char *)rx_frame.data);
+				if (reply_with_ack)
+				{
+					//	Answer to next message from this pipe, no RX/TX turnaround
+					nrf24_write_ack_payload(&radio,rx_frame.pipe,(uint8_t *)tx_message,strlen(tx_message));
+					continue;
+				}
+				//	Without AUTO_ACK send message as response
+				_delay_ms(500);
+				status = nrf24_send_message(&radio,tx_message);
+				if (status) printf("Message sent successfully\n");
+			}
 		}
+		
+		//	Driver log goes out here, away from radio timing
+		nrf24_log_flush();
     }
 }
 
 //	Interrupt on IRQ pin
 ISR(INT0_vect) 
+{
+	nrf24_irq(&radio);
+}
+
+//	Called from nrf24_irq() when RX_DR is raised
+void message_ready(nrf24_t *radio)
 {
 	message_received = true;
 }
 
-void print_config(void)
+void print_config(nrf24_t *radio)
 {
 	uint8_t data;
 	printf("Startup successful\n\n nRF24L01+ configured as:\n");
 	printf("-------------------------------------------\n");
-	nrf24_read(CONFIG,&data,1);
+	nrf24_read(radio,CONFIG,&data,1);
 	printf("CONFIG		0x%x\n",data);
-	nrf24_read(EN_AA,&data,1);
+	nrf24_read(radio,EN_AA,&data,1);
 	printf("EN_AA			0x%x\n",data);
-	nrf24_read(EN_RXADDR,&data,1);
+	nrf24_read(radio,EN_RXADDR,&data,1);
 	printf("EN_RXADDR		0x%x\n",data);
-	nrf24_read(SETUP_RETR,&data,1);
+	nrf24_read(radio,SETUP_RETR,&data,1);
 	printf("SETUP_RETR		0x%x\n",data);
-	nrf24_read(RF_CH,&data,1);
+	nrf24_read(radio,RF_CH,&data,1);
 	printf("RF_CH			0x%x\n",data);
-	nrf24_read(RF_SETUP,&data,1);
+	nrf24_read(radio,RF_SETUP,&data,1);
 	printf("RF_SETUP		0x%x\n",data);
-	nrf24_read(STATUS,&data,1);
+	nrf24_read(radio,STATUS,&data,1);
 	printf("STATUS		0x%x\n",data);
-	nrf24_read(FEATURE,&data,1);
+	nrf24_read(radio,FEATURE,&data,1);
 	printf("FEATURE		0x%x\n",data);
 	printf("-------------------------------------------\n\n");
 }
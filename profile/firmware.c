@@ -0,0 +1,84 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//
+//	Firmware for cycle profiling under simavr (see profile.c). Every measured call is wrapped
+//	in writes of its id to GPIOR0 (single OUT instruction), the harness takes cycle count on
+//	each write. Radio on the other end of SPI is a stub in the harness, it always has a
+//	message waiting so nrf24_read_message() reads one from the chip on every call.
+//
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifndef BAUD
+#define BAUD 9600
+#endif
+#include "STDIO_UART.h"
+
+#include "nrf24l01.h"
+#include "nrf24l01-mnemonics.h"
+#include "timer.h"
+#include "profile.h"
+
+nrf24_t radio = NRF24_RADIO(PORTB, PB1, PORTB, PB2, 0);
+
+ISR(INT0_vect)
+{
+	nrf24_irq(&radio);
+}
+
+int main(void)
+{
+	uint8_t buffer[32] = { 0 };
+	
+	uart_init();
+	timer_init();
+	nrf24_init(&radio);
+	
+	// IRQ pin is not driven by the stub, fill receive queue by hand
+	nrf24_irq(&radio);
+	
+	for (uint8_t i = 0; i < PROFILE_CALLS; i++)
+	{
+		PROFILE(PROFILE_SEND_MESSAGE, nrf24_send_message(&radio,"Hello World!"));
+		PROFILE(PROFILE_READ_MESSAGE, nrf24_read_message(&radio));
+		PROFILE(PROFILE_STATE_RECEIVE, nrf24_state(&radio,RECEIVE));
+		PROFILE(PROFILE_STATE_TRANSMIT, nrf24_state(&radio,TRANSMIT));
+		PROFILE(PROFILE_SEND_SPI_1, nrf24_send_spi(&radio,R_REGISTER | CONFIG,buffer,1));
+		PROFILE(PROFILE_SEND_SPI_32, nrf24_send_spi(&radio,R_RX_PAYLOAD,buffer,32));
+	}
+	
+	// Harness stops on this mark
+	GPIOR0 = PROFILE_DONE;
+	cli();
+	sleep_enable();
+	sleep_cpu();
+	return 0;
+}
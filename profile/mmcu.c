@@ -0,0 +1,4 @@
+//	MCU and clock for simavr, kept in .mmcu section of the ELF
+#include <simavr/avr/avr_mcu_section.h>
+
+AVR_MCU(F_CPU, "atmega328p");
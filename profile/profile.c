@@ -0,0 +1,274 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//
+//	Runs firmware.elf in simavr (ATmega328P @ 16MHz) with a stub nRF24L01+ on SPI and
+//	reports cycles per call of the profiled functions (ids in profile.h) and per SPI byte.
+//	Budgets come from budgets.csv, recorded from a run with -r (worst call + 25%). Exits with 1
+//	when a call goes over its budget or a function has none, 2 when firmware does not run.
+//
+//	profile [-r] [firmware.elf [budgets.csv]]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_irq.h>
+#include <simavr/avr_spi.h>
+#include <simavr/avr_ioport.h>
+
+#include "nrf24l01-mnemonics.h"
+#include "profile.h"
+
+#define PROFILE_GPIOR0		0x3E				// GPIOR0 in data space (I/O 0x1E)
+
+//	Recorded budget is worst call plus this share (1/n), rounded up to 100 cycles
+#define PROFILE_MARGIN		4
+
+//	Names as in budgets.csv, ids from profile.h
+static const char *functions[PROFILE_FUNCTIONS] =
+{
+	[PROFILE_SEND_MESSAGE] = "nrf24_send_message",
+	[PROFILE_READ_MESSAGE] = "nrf24_read_message",
+	[PROFILE_STATE_RECEIVE] = "nrf24_state(RECEIVE)",
+	[PROFILE_STATE_TRANSMIT] = "nrf24_state(TRANSMIT)",
+	[PROFILE_SEND_SPI_1] = "nrf24_send_spi(1)",
+	[PROFILE_SEND_SPI_32] = "nrf24_send_spi(32)",
+};
+
+//	Worst call allowed (cycles), 0 = not recorded
+static unsigned long budgets[PROFILE_FUNCTIONS];
+
+static struct
+{
+	uint32_t calls;
+	uint64_t total;
+	uint64_t min;
+	uint64_t max;
+} results[PROFILE_FUNCTIONS];
+
+static avr_t *avr;
+static avr_irq_t *spi_input;
+static uint8_t current;
+static avr_cycle_count_t started;
+static bool done;
+
+// ---- Stub nRF24L01+: registers answer, payloads are always accepted and sent (TX_DS),
+// RX FIFO is never empty and every read brings a new message (RX_DR) ----
+
+static uint8_t registers[0x20] = { [CONFIG] = 0x08, [EN_AA] = 0x3F, [EN_RXADDR] = 0x03, [SETUP_AW] = 0x03,
+	[SETUP_RETR] = 0x03, [RF_CH] = 0x02, [RF_SETUP] = 0x0E, [FIFO_STATUS] = (1 << TX_EMPTY) };
+static uint8_t flags = (1 << RX_DR);
+static uint8_t command;
+static uint8_t position;
+
+static uint8_t stub_status(void)
+{
+	// Message waiting on pipe 0, TX FIFO never full
+	return flags | (0 << RX_P_NO);
+}
+
+static uint8_t stub_byte(uint8_t value)
+{
+	uint8_t reply = 0;
+	uint8_t address = command & REGISTER_MASK;
+	
+	if (position == 0)
+	{
+		command = value;
+		reply = stub_status();
+		if (command == W_TX_PAYLOAD || command == W_TX_PAYLOAD_NOACK) flags |= (1 << TX_DS);
+		if (command == R_RX_PAYLOAD) flags |= (1 << RX_DR);
+	}
+	else if ((command & ~REGISTER_MASK) == R_REGISTER) reply = address == STATUS ? stub_status() : registers[address];
+	else if ((command & ~REGISTER_MASK) == W_REGISTER)
+	{
+		if (address == STATUS) flags &= ~(value & 0x70);
+		else if (position == 1) registers[address] = value;
+	}
+	else if (command == R_RX_PL_WID) reply = 32;
+	else if (command == R_RX_PAYLOAD) reply = 'A' + (position - 1) % 26;
+	
+	position++;
+	return reply;
+}
+
+static void spi_output(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+	avr_raise_irq(spi_input,stub_byte(value));
+}
+
+static void csn_changed(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+	// New command starts with CSN going low
+	if (!value) position = 0;
+}
+
+// ---- Budgets ----
+
+static void read_budgets(const char *path)
+{
+	FILE *file = fopen(path,"r");
+	char name[64];
+	unsigned long budget;
+	
+	// Header line, then 'function,budget' per line
+	if (!file) return;
+	if (!fgets(name,sizeof(name),file))
+	{
+		fclose(file);
+		return;
+	}
+	while (fscanf(file,"%63[^,],%lu\n",name,&budget) == 2)
+	{
+		for (uint8_t i = 1; i < PROFILE_FUNCTIONS; i++)
+		{
+			if (!strcmp(name,functions[i])) budgets[i] = budget;
+		}
+	}
+	fclose(file);
+}
+
+static bool write_budgets(const char *path)
+{
+	FILE *file = fopen(path,"w");
+	uint64_t budget;
+	
+	if (!file) return false;
+	fprintf(file,"function,budget\n");
+	for (uint8_t i = 1; i < PROFILE_FUNCTIONS; i++)
+	{
+		budget = (results[i].max + results[i].max / PROFILE_MARGIN + 99) / 100 * 100;
+		fprintf(file,"%s,%llu\n",functions[i],(unsigned long long)budget);
+	}
+	return fclose(file) == 0;
+}
+
+// ---- Marks from firmware ----
+
+static void gpior0_write(struct avr_t *avr, avr_io_addr_t address, uint8_t value, void *param)
+{
+	uint64_t cycles;
+	
+	avr->data[address] = value;
+	if (value == PROFILE_DONE)
+	{
+		done = true;
+		return;
+	}
+	if (value)
+	{
+		current = value < PROFILE_FUNCTIONS ? value : 0;
+		started = avr->cycle;
+		return;
+	}
+	if (!current) return;
+	
+	// Take off OUT of the starting mark
+	cycles = avr->cycle - started - 1;
+	if (!results[current].calls || cycles < results[current].min) results[current].min = cycles;
+	if (cycles > results[current].max) results[current].max = cycles;
+	results[current].total += cycles;
+	results[current].calls++;
+	current = 0;
+}
+
+int main(int argc, char **argv)
+{
+	elf_firmware_t firmware = { { 0 } };
+	bool record = argc > 1 && !strcmp(argv[1],"-r");
+	const char *path = argc > 1 + record ? argv[1 + record] : "firmware.elf";
+	const char *budget_path = argc > 2 + record ? argv[2 + record] : "budgets.csv";
+	int state;
+	bool failed = false;
+	
+	if (elf_read_firmware(path,&firmware))
+	{
+		fprintf(stderr,"Cannot read %s\n",path);
+		return 2;
+	}
+	avr = avr_make_mcu_by_name("atmega328p");
+	if (!avr) return 2;
+	avr_init(avr);
+	avr_load_firmware(avr,&firmware);
+	avr->frequency = 16000000;
+	
+	spi_input = avr_io_getirq(avr,AVR_IOCTL_SPI_GETIRQ(0),SPI_IRQ_INPUT);
+	avr_irq_register_notify(avr_io_getirq(avr,AVR_IOCTL_SPI_GETIRQ(0),SPI_IRQ_OUTPUT),spi_output,NULL);
+	avr_irq_register_notify(avr_io_getirq(avr,AVR_IOCTL_IOPORT_GETIRQ('B'),2),csn_changed,NULL);
+	avr_register_io_write(avr,PROFILE_GPIOR0,gpior0_write,NULL);
+	
+	do state = avr_run(avr);
+	while (!done && state != cpu_Done && state != cpu_Crashed);
+	
+	if (!done)
+	{
+		fprintf(stderr,"Firmware stopped before finishing (state %d)\n",state);
+		return 2;
+	}
+	
+	for (uint8_t i = 1; i < PROFILE_FUNCTIONS; i++)
+	{
+		if (results[i].calls) continue;
+		fprintf(stderr,"%s was not called\n",functions[i]);
+		return 2;
+	}
+	
+	// New budgets from this run, or check against recorded ones
+	if (record && !write_budgets(budget_path))
+	{
+		fprintf(stderr,"Cannot write %s\n",budget_path);
+		return 2;
+	}
+	read_budgets(budget_path);
+	
+	printf("function,calls,cycles_min,cycles_avg,cycles_max,budget\n");
+	for (uint8_t i = 1; i < PROFILE_FUNCTIONS; i++)
+	{
+		printf("%s,%u,%llu,%llu,%llu,%lu\n",functions[i],results[i].calls,
+			(unsigned long long)results[i].min,(unsigned long long)(results[i].total / results[i].calls),
+			(unsigned long long)results[i].max,budgets[i]);
+		if (!budgets[i])
+		{
+			fprintf(stderr,"%s has no budget in %s, record one with 'make -C profile budgets'\n",functions[i],budget_path);
+			failed = true;
+		}
+		else if (results[i].max > budgets[i])
+		{
+			fprintf(stderr,"%s over budget: %llu > %lu cycles\n",functions[i],(unsigned long long)results[i].max,budgets[i]);
+			failed = true;
+		}
+	}
+	
+	// Cost of one more byte in a transfer, SPIF polling included
+	if (results[PROFILE_SEND_SPI_1].calls && results[PROFILE_SEND_SPI_32].calls)
+	{
+		printf("spi_byte,,,%.1f,,\n",((double)results[PROFILE_SEND_SPI_32].total / results[PROFILE_SEND_SPI_32].calls -
+			(double)results[PROFILE_SEND_SPI_1].total / results[PROFILE_SEND_SPI_1].calls) / 31);
+	}
+	return failed;
+}
@@ -0,0 +1,41 @@
+// MIT License
+//
+// Copyright (c) 2018 Helvijs Adams
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+//	Ids written to GPIOR0 by firmware, shared with harness
+#define PROFILE_SEND_MESSAGE	1
+#define PROFILE_READ_MESSAGE	2
+#define PROFILE_STATE_RECEIVE	3
+#define PROFILE_STATE_TRANSMIT	4
+#define PROFILE_SEND_SPI_1		5
+#define PROFILE_SEND_SPI_32		6
+#define PROFILE_FUNCTIONS		7
+#define PROFILE_DONE			0xFF
+
+#define PROFILE_CALLS			16
+
+//	Mark is one OUT instruction (1 cycle) on each side of the call
+#define PROFILE(id, call)		do { GPIOR0 = (id); call; GPIOR0 = 0; } while (0)
+
+#endif /*_PROFILE_H*/